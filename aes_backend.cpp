@@ -0,0 +1,208 @@
+#include "aes_backend.h"
+#include "aes_soft.h"
+#include "aes_vectors.h"
+
+#include "mbed.h"
+#include "mbedtls/aes.h"
+#include "mbedtls/cipher.h"
+#include "mbedtls/cmac.h"
+
+#include <string.h>
+
+/**
+ * Frames timed for the benchmark
+ */
+#define AES_BENCH_FRAMES    100
+
+#if defined(MBEDTLS_AES_ENCRYPT_ALT)
+/**
+ * AES encryption on the STM32WL AES peripheral.
+ *
+ * mbedtls keeps doing the key schedule, the first round key words are the
+ * raw key so we load that into the peripheral and only reload it when the
+ * key changes. A new key only goes through HAL_CRYP_SetConfig(), the next
+ * HAL_CRYP_Encrypt() writes it to the peripheral. The LoRaWAN stack runs
+ * from a single thread so there's no locking. If the peripheral fails we
+ * carry on with aes_soft_encrypt() on the same round keys.
+ */
+static bool use_software = false;   // until the next reset
+
+static CRYP_HandleTypeDef hcryp;
+static uint32_t hw_key[8];
+static int hw_key_words = 0;
+
+static uint32_t swap_bytes(uint32_t x) {
+    return (x >> 24) | ((x >> 8) & 0xFF00) | ((x << 8) & 0xFF0000) | (x << 24);
+}
+
+int mbedtls_internal_aes_encrypt(mbedtls_aes_context *ctx,
+                                 const unsigned char input[16],
+                                 unsigned char output[16])
+{
+    uint32_t key[8];
+    uint32_t in[4];
+    uint32_t out[4];
+    int words;
+
+    if (use_software) {
+        aes_soft_encrypt(ctx->rk, ctx->nr, input, output);
+        return 0;
+    }
+
+    // The peripheral has no 192 bit keys, and LoRaWAN doesn't need them
+    if (ctx->nr == 10) {
+        words = 4;
+    } else if (ctx->nr == 14) {
+        words = 8;
+    } else {
+        return MBEDTLS_ERR_AES_INVALID_KEY_LENGTH;
+    }
+
+    for (int i = 0; i < words; i++) {
+        key[i] = swap_bytes(ctx->rk[i]);
+    }
+
+    if (words != hw_key_words || memcmp(key, hw_key, words * sizeof(uint32_t))) {
+        HAL_StatusTypeDef status;
+
+        memcpy(hw_key, key, words * sizeof(uint32_t));
+
+        if (hw_key_words) {
+            // The stack swaps between AppSKey and NwkSKey every frame, only
+            // the key changes so don't take the peripheral down for it
+            CRYP_ConfigTypeDef config;
+            HAL_CRYP_GetConfig(&hcryp, &config);
+            config.KeySize = (words == 4) ? CRYP_KEYSIZE_128B : CRYP_KEYSIZE_256B;
+            config.pKey = hw_key;
+            status = HAL_CRYP_SetConfig(&hcryp, &config);
+        } else {
+            __HAL_RCC_AES_CLK_ENABLE();
+            memset(&hcryp, 0, sizeof(hcryp));
+            hcryp.Instance = AES;
+            hcryp.Init.DataType = CRYP_DATATYPE_8B;
+            hcryp.Init.KeySize = (words == 4) ? CRYP_KEYSIZE_128B : CRYP_KEYSIZE_256B;
+            hcryp.Init.pKey = hw_key;
+            hcryp.Init.Algorithm = CRYP_AES_ECB;
+            hcryp.Init.DataWidthUnit = CRYP_DATAWIDTHUNIT_BYTE;
+            hcryp.Init.KeyIVConfigSkip = CRYP_KEYIVCONFIG_ONCE;
+            status = HAL_CRYP_Init(&hcryp);
+        }
+
+        if (status != HAL_OK) {
+            use_software = true;
+            aes_soft_encrypt(ctx->rk, ctx->nr, input, output);
+            return 0;
+        }
+        hw_key_words = words;
+    }
+
+    memcpy(in, input, sizeof(in));
+    if (HAL_CRYP_Encrypt(&hcryp, in, sizeof(in), out, 10) != HAL_OK) {
+        use_software = true;
+        aes_soft_encrypt(ctx->rk, ctx->nr, input, output);
+        return 0;
+    }
+    memcpy(output, out, sizeof(out));
+    return 0;
+}
+#endif
+
+const char *aes_backend_name(void) {
+#if defined(MBEDTLS_AES_ENCRYPT_ALT)
+    return use_software ? "software fallback" : "STM32WL hardware";
+#elif defined(MBEDTLS_AES_FEWER_TABLES)
+    return "software (small tables)";
+#else
+    return "software (full tables)";
+#endif
+}
+
+/**
+ * Check the known answers with whatever backend is in use
+ */
+static bool known_answers(void) {
+    mbedtls_aes_context aes;
+    uint8_t block[16];
+    uint8_t message[sizeof(lorawan_b0) + sizeof(lorawan_frame)];
+    bool ok = true;
+
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, aes_key, 128);
+    if (mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, aes_plain, block) != 0
+            || memcmp(block, aes_cipher, sizeof(block))) {
+        printf("\r\n AES known answer test failed! \r\n");
+        ok = false;
+    }
+
+    // FRMPayload, decrypted the way the stack encrypts it
+    mbedtls_aes_setkey_enc(&aes, lorawan_app_skey, 128);
+    if (mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, lorawan_a1, block) != 0) {
+        ok = false;
+    }
+    for (size_t i = 0; i < sizeof(lorawan_plain); i++) {
+        if ((lorawan_frame[LORAWAN_PAYLOAD_OFFSET + i] ^ block[i]) != lorawan_plain[i]) {
+            printf("\r\n LoRaWAN payload known answer test failed! \r\n");
+            ok = false;
+            break;
+        }
+    }
+
+    // MIC, AES-CMAC over B0 and the frame
+    const mbedtls_cipher_info_t *cipher = mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_AES_128_ECB);
+    memcpy(message, lorawan_b0, sizeof(lorawan_b0));
+    memcpy(message + sizeof(lorawan_b0), lorawan_frame, sizeof(lorawan_frame));
+    if (mbedtls_cipher_cmac(cipher, lorawan_nwk_skey, 128, message, sizeof(message), block) != 0
+            || memcmp(block, lorawan_mic, sizeof(lorawan_mic))) {
+        printf("\r\n LoRaWAN MIC known answer test failed! \r\n");
+        ok = false;
+    }
+
+    mbedtls_aes_free(&aes);
+    return ok;
+}
+
+/**
+ * Time a frame: one block of payload encryption plus the MIC
+ */
+static void benchmark(void) {
+    mbedtls_aes_context aes;
+    uint8_t block[16];
+    uint8_t message[sizeof(lorawan_b0) + sizeof(lorawan_frame)];
+    const mbedtls_cipher_info_t *cipher = mbedtls_cipher_info_from_type(MBEDTLS_CIPHER_AES_128_ECB);
+
+    memcpy(message, lorawan_b0, sizeof(lorawan_b0));
+    memcpy(message + sizeof(lorawan_b0), lorawan_frame, sizeof(lorawan_frame));
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, lorawan_app_skey, 128);
+
+    Timer timer;
+    timer.start();
+    for (int i = 0; i < AES_BENCH_FRAMES; i++) {
+        mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, lorawan_a1, block);
+        mbedtls_cipher_cmac(cipher, lorawan_nwk_skey, 128, message, sizeof(message), block);
+    }
+    timer.stop();
+    uint64_t us = timer.elapsed_time().count() / AES_BENCH_FRAMES;
+    printf("\r\n AES: %llu us, %llu cycles per frame \r\n", (unsigned long long)us,
+           (unsigned long long)(us * (SystemCoreClock / 1000000)));
+
+    mbedtls_aes_free(&aes);
+}
+
+bool aes_backend_self_test(void) {
+    printf("\r\n AES backend: %s \r\n", aes_backend_name());
+
+    bool ok = known_answers();
+#if defined(MBEDTLS_AES_ENCRYPT_ALT)
+    if (!ok && !use_software) {
+        printf("\r\n Falling back to software AES \r\n");
+        use_software = true;
+        ok = known_answers();
+    }
+#endif
+
+    if (ok) {
+        benchmark();
+    }
+    return ok;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+/**
+ * Name of the AES backend selected with app.aes-backend
+ */
+const char *aes_backend_name(void);
+
+/**
+ * Check AES and AES-CMAC against known answers and print how long a
+ * LoRaWAN sized frame takes. Returns false if any answer is wrong.
+ */
+bool aes_backend_self_test(void);
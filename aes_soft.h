@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Round key words for AES-128
+ */
+#define AES_SOFT_RK_WORDS   44
+
+/**
+ * Table-free AES encryption, used when the AES peripheral fails.
+ *
+ * Round keys are in the mbedtls layout, little-endian words starting with
+ * the raw key, so the key schedule mbedtls already did can be used as is.
+ */
+void aes_soft_encrypt(const uint32_t *rk, int rounds, const uint8_t input[16], uint8_t output[16]);
+
+/**
+ * AES-128 key schedule in the same layout, mbedtls does this on target
+ */
+void aes_soft_expand_key(const uint8_t key[16], uint32_t rk[AES_SOFT_RK_WORDS]);
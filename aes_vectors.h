@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Known answers for the AES self-test, shared with the host test
+ */
+
+/**
+ * FIPS-197 appendix C.1
+ */
+static const uint8_t aes_key[16] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+static const uint8_t aes_plain[16] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+};
+static const uint8_t aes_cipher[16] = {
+    0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+    0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a
+};
+
+/**
+ * LoRaWAN 1.0 unconfirmed uplink from DevAddr 49BE7DF1, FCnt 2, FPort 1
+ * carrying "test". The MIC is the first 4 bytes of the CMAC with the
+ * network session key over B0 and the frame, FRMPayload is XORed with the
+ * encrypted A1 block under the application session key.
+ */
+static const uint8_t lorawan_nwk_skey[16] = {
+    0x44, 0x02, 0x42, 0x41, 0xed, 0x4c, 0xe9, 0xa6,
+    0x8c, 0x6a, 0x8b, 0xc0, 0x55, 0x23, 0x3f, 0xd3
+};
+static const uint8_t lorawan_app_skey[16] = {
+    0xec, 0x92, 0x58, 0x02, 0xae, 0x43, 0x0c, 0xa7,
+    0x7f, 0xd3, 0xdd, 0x73, 0xcb, 0x2c, 0xc5, 0x88
+};
+static const uint8_t lorawan_frame[13] = {
+    0x40, 0xf1, 0x7d, 0xbe, 0x49, 0x00, 0x02, 0x00,     // MHDR, DevAddr, FCtrl, FCnt
+    0x01, 0x95, 0x43, 0x78, 0x76                        // FPort, FRMPayload
+};
+static const uint8_t lorawan_b0[16] = {
+    0x49, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf1, 0x7d,
+    0xbe, 0x49, 0x02, 0x00, 0x00, 0x00, 0x00, sizeof(lorawan_frame)
+};
+static const uint8_t lorawan_a1[16] = {
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf1, 0x7d,
+    0xbe, 0x49, 0x02, 0x00, 0x00, 0x00, 0x00, 0x01
+};
+static const uint8_t lorawan_mic[4] = {0x2b, 0x11, 0xff, 0x0d};
+static const uint8_t lorawan_plain[4] = {'t', 'e', 's', 't'};
+
+#define LORAWAN_PAYLOAD_OFFSET  9
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "mbed.h"
+
+/**
+ * Boards we know how to run on. Each target in custom_targets.json picks
+ * one with APP_BOARD in its macros_add.
+ */
+enum board_id_t {
+    BOARD_LORA_E5,
+    BOARD_RAK3172,
+    BOARD_RAK3172SIP,
+    BOARD_LORA_E5_MINIMAL
+};
+
+/**
+ * How the GPS is powered down between fixes
+ */
+enum gps_power_t {
+    GPS_POWER_SWITCH,   // load switch on gps_power
+    GPS_POWER_STANDBY   // always powered, PMTK standby command over the UART
+};
+
+/**
+ * Radio driver, must agree with lora_radio_helper.h. Every board so far is
+ * an STM32WL module; add the driver there along with a board that needs it.
+ */
+enum radio_t {
+    RADIO_STM32WL
+};
+
+/**
+ * Pins and hardware present on a board. Everything is constexpr so code
+ * for missing hardware is dropped at compile time.
+ */
+template <board_id_t Id>
+struct BoardProfile;
+
+/**
+ * LoRa-E5 tracker, the original board
+ */
+template <>
+struct BoardProfile<BOARD_LORA_E5> {
+    static constexpr radio_t radio = RADIO_STM32WL;
+
+    static constexpr gps_power_t gps_power_style = GPS_POWER_SWITCH;
+    static constexpr PinName gps_power = PB_5;
+    static constexpr PinName gps_tx = PB_6;
+    static constexpr PinName gps_rx = PB_7;
+    static constexpr int gps_baud = 9600;
+
+    static constexpr PinName battery_adc = PB_3;
+    static constexpr float adc_reference = 3.3f;    // V
+    static constexpr float battery_divider = 2.0f;  // battery V / ADC V
+
+    static constexpr bool has_bmp280 = true;
+    static constexpr PinName bmp280_sda = PA_11;
+    static constexpr PinName bmp280_scl = PA_12;
+    static constexpr char bmp280_address = 0x76;
+};
+
+/**
+ * RAK3172 modules on the same wiring as the LoRa-E5
+ */
+template <>
+struct BoardProfile<BOARD_RAK3172> : BoardProfile<BOARD_LORA_E5> {};
+
+template <>
+struct BoardProfile<BOARD_RAK3172SIP> : BoardProfile<BOARD_LORA_E5> {};
+
+/**
+ * LoRa-E5 with just the GPS, kept powered and put in standby between fixes
+ */
+template <>
+struct BoardProfile<BOARD_LORA_E5_MINIMAL> : BoardProfile<BOARD_LORA_E5> {
+    static constexpr gps_power_t gps_power_style = GPS_POWER_STANDBY;
+    static constexpr PinName gps_power = NC;
+
+    static constexpr bool has_bmp280 = false;
+    static constexpr PinName bmp280_sda = NC;
+    static constexpr PinName bmp280_scl = NC;
+};
+
+#ifndef APP_BOARD
+#error "No board profile, add APP_BOARD to the target's macros_add in custom_targets.json"
+#endif
+
+typedef BoardProfile<APP_BOARD> Board;
@@ -0,0 +1,134 @@
+#include "evq_profiler.h"
+
+#include "events/equeue.h"
+
+#ifndef APP_EVQ_WRAP_ALLOC
+#define APP_EVQ_WRAP_ALLOC  0
+#endif
+
+#if MBED_CONF_APP_EVQ_PROFILE && APP_EVQ_WRAP_ALLOC
+static ProfiledEventQueue *profiled_queue;
+
+static void alloc_hook(struct equeue *q, void *e) {
+    profiled_queue->allocated(q, e != NULL);
+}
+#endif
+
+ProfiledEventQueue::ProfiledEventQueue(size_t size)
+    : EventQueue(size)
+#if MBED_CONF_APP_EVQ_PROFILE
+    , _size(size),
+      _stats(size, EVENTS_EVENT_SIZE)
+#endif
+{
+#if MBED_CONF_APP_EVQ_PROFILE && APP_EVQ_WRAP_ALLOC
+    profiled_queue = this;
+    evq_set_alloc_hook(alloc_hook);
+#endif
+}
+
+uint32_t ProfiledEventQueue::now_ms(void) {
+    // Kernel ticks keep counting through deep sleep, unlike us_ticker
+    return (uint32_t)Kernel::Clock::now().time_since_epoch().count();
+}
+
+uint32_t ProfiledEventQueue::idle_ms(void) const {
+#if MBED_CONF_APP_EVQ_PROFILE
+    return _stats.idle_ms();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Bytes of the queue buffer in use, i.e. not in the slab or free chunks.
+ * Call with memlock held.
+ */
+size_t ProfiledEventQueue::used(void) {
+    size_t free_bytes = evq_free_bytes(_equeue.slab.size, _equeue.chunks);
+    return free_bytes > _size ? 0 : _size - free_bytes;
+}
+
+/**
+ * The stats are only touched with memlock held, which on mbed is a
+ * critical section, so the alloc wrap can update them from interrupts
+ */
+void ProfiledEventQueue::sample(void) {
+#if MBED_CONF_APP_EVQ_PROFILE
+    equeue_mutex_lock(&_equeue.memlock);
+    _stats.sample(used());
+    equeue_mutex_unlock(&_equeue.memlock);
+#endif
+}
+
+void ProfiledEventQueue::allocated(const equeue_t *q, bool ok) {
+#if MBED_CONF_APP_EVQ_PROFILE
+    if (q != &_equeue) {
+        return;
+    }
+    equeue_mutex_lock(&_equeue.memlock);
+    if (!ok) {
+        _stats.post_failed();
+    }
+    _stats.sample(used());
+    equeue_mutex_unlock(&_equeue.memlock);
+#endif
+}
+
+void ProfiledEventQueue::posted_event(int id) {
+#if MBED_CONF_APP_EVQ_PROFILE && !APP_EVQ_WRAP_ALLOC
+    // With the wrap this post was already seen by allocated()
+    if (!id) {
+        equeue_mutex_lock(&_equeue.memlock);
+        _stats.post_failed();
+        equeue_mutex_unlock(&_equeue.memlock);
+    }
+    sample();
+#endif
+}
+
+void ProfiledEventQueue::finished(uint8_t slot, uint32_t posted, uint32_t start, uint32_t idle) {
+#if MBED_CONF_APP_EVQ_PROFILE
+    _stats.finished(slot, start - posted, now_ms() - start, idle);
+    sample();
+#endif
+}
+
+size_t ProfiledEventQueue::peak_used(void) const {
+#if MBED_CONF_APP_EVQ_PROFILE
+    return _stats.peak_used();
+#else
+    return 0;
+#endif
+}
+
+uint8_t ProfiledEventQueue::peak_percent(void) const {
+#if MBED_CONF_APP_EVQ_PROFILE
+    return _stats.peak_percent();
+#else
+    return 0;
+#endif
+}
+
+uint32_t ProfiledEventQueue::post_failures(void) const {
+#if MBED_CONF_APP_EVQ_PROFILE
+    return _stats.post_failures();
+#else
+    return 0;
+#endif
+}
+
+uint32_t ProfiledEventQueue::full_samples(void) const {
+#if MBED_CONF_APP_EVQ_PROFILE
+    return _stats.full_samples();
+#else
+    return 0;
+#endif
+}
+
+void ProfiledEventQueue::dump(void) {
+#if MBED_CONF_APP_EVQ_PROFILE
+    sample();
+    _stats.dump();
+#endif
+}
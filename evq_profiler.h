@@ -0,0 +1,109 @@
+#pragma once
+
+#include "mbed.h"
+#include "events/EventQueue.h"
+
+#include "evq_stats.h"
+
+#ifndef MBED_CONF_APP_EVQ_PROFILE
+#define MBED_CONF_APP_EVQ_PROFILE   0
+#endif
+
+/**
+ * EventQueue that keeps track of how full it gets and how long callbacks
+ * wait and run for.
+ *
+ * The LoRaWAN stack posts with plain call(). Its posts are seen by
+ * wrapping equeue_alloc() at link time (APP_EVQ_WRAP_ALLOC, set by the
+ * CMake build with GCC_ARM): every allocation on this queue samples the
+ * occupancy and every failed one is counted. Without the wrap only
+ * profiled_call() failures are counted, and occupancy is sampled when
+ * profiled callbacks are posted and run, so samples where the queue was
+ * full are the hint that the stack lost events.
+ *
+ * Application events go through profiled_call(), and the stack's
+ * application callback can be wrapped with profile(). Sleeping and
+ * waiting for GPS inside a callback go through idle(), so they don't
+ * count as execution time.
+ */
+class ProfiledEventQueue : public events::EventQueue {
+public:
+    explicit ProfiledEventQueue(size_t size);
+
+    /**
+     * call() that records wait and execution time in a slot
+     */
+    template <typename F>
+    int profiled_call(uint8_t slot, F f) {
+#if MBED_CONF_APP_EVQ_PROFILE
+        uint32_t posted = now_ms();
+        int id = call([this, slot, posted, f]() mutable {
+            run(slot, posted, f);
+        });
+        posted_event(id);
+        return id;
+#else
+        return call(f);
+#endif
+    }
+
+    /**
+     * Run f now, recording its execution time in a slot
+     */
+    template <typename F>
+    void profile(uint8_t slot, F f) {
+#if MBED_CONF_APP_EVQ_PROFILE
+        run(slot, now_ms(), f);
+#else
+        f();
+#endif
+    }
+
+    /**
+     * Run f, a deliberate wait such as a sleep or the GPS window, and
+     * leave its time out of the running callback's execution time
+     */
+    template <typename F>
+    void idle(F f) {
+#if MBED_CONF_APP_EVQ_PROFILE
+        uint32_t start = now_ms();
+        f();
+        _stats.idle(now_ms() - start);
+#else
+        f();
+#endif
+    }
+
+    size_t peak_used(void) const;
+    uint8_t peak_percent(void) const;
+    uint32_t post_failures(void) const;
+    uint32_t full_samples(void) const;
+    void dump(void);
+
+    /**
+     * Called by the equeue_alloc() wrap for every allocation, from any context
+     */
+    void allocated(const equeue_t *q, bool ok);
+
+private:
+    template <typename F>
+    void run(uint8_t slot, uint32_t posted, F &f) {
+        uint32_t start = now_ms();
+        uint32_t idle = idle_ms();
+        sample();
+        f();
+        finished(slot, posted, start, idle);
+    }
+
+    static uint32_t now_ms(void);
+    uint32_t idle_ms(void) const;
+    size_t used(void);
+    void sample(void);
+    void posted_event(int id);
+    void finished(uint8_t slot, uint32_t posted, uint32_t start, uint32_t idle);
+
+#if MBED_CONF_APP_EVQ_PROFILE
+    size_t _size;
+    EvqStats _stats;
+#endif
+};
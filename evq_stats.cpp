@@ -0,0 +1,137 @@
+#include "evq_stats.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef APP_EVQ_WRAP_ALLOC
+#define APP_EVQ_WRAP_ALLOC  0
+#endif
+
+static evq_alloc_hook_t alloc_hook;
+
+void evq_set_alloc_hook(evq_alloc_hook_t hook) {
+    alloc_hook = hook;
+}
+
+#if APP_EVQ_WRAP_ALLOC
+extern "C" void *__real_equeue_alloc(struct equeue *q, size_t size);
+
+/**
+ * Linked in place of equeue_alloc() with -Wl,--wrap=equeue_alloc. Calls
+ * from inside equeue.c aren't redirected, but EventQueue::call() and
+ * Event::post() allocate from the caller's code, which is where the
+ * LoRaWAN stack's posts come from.
+ */
+extern "C" void *__wrap_equeue_alloc(struct equeue *q, size_t size) {
+    void *e = __real_equeue_alloc(q, size);
+    if (alloc_hook) {
+        alloc_hook(q, e);
+    }
+    return e;
+}
+#endif
+
+EvqStats::EvqStats(size_t size, size_t event_size)
+    : _size(size),
+      _event_size(event_size),
+      _peak_used(0),
+      _post_failures(0),
+      _full_samples(0),
+      _idle_ms(0)
+{
+    memset(_slots, 0, sizeof(_slots));
+}
+
+void EvqStats::sample(size_t used) {
+    if (used > _peak_used) {
+        _peak_used = used;
+    }
+    if (used > _size || _size - used < _event_size) {
+        _full_samples++;
+    }
+}
+
+void EvqStats::post_failed(void) {
+    _post_failures++;
+}
+
+static void histogram_add(uint16_t *hist, uint32_t ms) {
+    uint8_t bucket = 0;
+    while (ms && bucket < EVQ_HIST_BUCKETS - 1) {
+        ms >>= 2;
+        bucket++;
+    }
+    if (hist[bucket] < 0xFFFF) {
+        hist[bucket]++;
+    }
+}
+
+void EvqStats::idle(uint32_t ms) {
+    _idle_ms += ms;
+}
+
+void EvqStats::finished(uint8_t slot, uint32_t wait, uint32_t elapsed, uint32_t idle_at_start) {
+    evq_slot_stats_t &stats = _slots[slot < EVQ_PROFILE_SLOTS ? slot : EVQ_PROFILE_SLOTS - 1];
+    uint32_t idle = _idle_ms - idle_at_start;
+    uint32_t exec = elapsed > idle ? elapsed - idle : 0;
+
+    stats.count++;
+    if (exec > stats.max_exec) {
+        stats.max_exec = exec;
+    }
+    if (wait > stats.max_wait) {
+        stats.max_wait = wait;
+    }
+    histogram_add(stats.exec_hist, exec);
+    histogram_add(stats.wait_hist, wait);
+}
+
+size_t EvqStats::size(void) const {
+    return _size;
+}
+
+size_t EvqStats::peak_used(void) const {
+    return _peak_used;
+}
+
+uint8_t EvqStats::peak_percent(void) const {
+    return _size ? (_peak_used * 100) / _size : 0;
+}
+
+uint32_t EvqStats::post_failures(void) const {
+    return _post_failures;
+}
+
+uint32_t EvqStats::full_samples(void) const {
+    return _full_samples;
+}
+
+uint32_t EvqStats::idle_ms(void) const {
+    return _idle_ms;
+}
+
+const evq_slot_stats_t &EvqStats::slot(uint8_t slot) const {
+    return _slots[slot < EVQ_PROFILE_SLOTS ? slot : EVQ_PROFILE_SLOTS - 1];
+}
+
+void EvqStats::dump(void) const {
+    printf("\r\n Event queue: %u of %u bytes peak (%u%%), %lu failed posts, full on %lu samples \r\n",
+           (unsigned)_peak_used, (unsigned)_size, peak_percent(),
+           (unsigned long)_post_failures, (unsigned long)_full_samples);
+    for (uint8_t i = 0; i < EVQ_PROFILE_SLOTS; i++) {
+        const evq_slot_stats_t &stats = _slots[i];
+        if (!stats.count) {
+            continue;
+        }
+        printf(" slot %2u: %lu runs, max exec %lu ms, max wait %lu ms\r\n   exec:",
+               i, (unsigned long)stats.count, (unsigned long)stats.max_exec, (unsigned long)stats.max_wait);
+        for (uint8_t b = 0; b < EVQ_HIST_BUCKETS; b++) {
+            printf(" %u", stats.exec_hist[b]);
+        }
+        printf("\r\n   wait:");
+        for (uint8_t b = 0; b < EVQ_HIST_BUCKETS; b++) {
+            printf(" %u", stats.wait_hist[b]);
+        }
+        printf("\r\n");
+    }
+}
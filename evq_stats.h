@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Callbacks are profiled per slot, anything past the last slot shares it
+ */
+#define EVQ_PROFILE_SLOTS   16
+
+/**
+ * Histogram buckets, 0 ms then x4 per bucket: 1-3, 4-15, ... 4096+ ms
+ */
+#define EVQ_HIST_BUCKETS    8
+
+struct evq_slot_stats_t {
+    uint32_t count;
+    uint32_t max_exec;                      // ms, less any idle() time
+    uint32_t max_wait;                      // ms, only for profiled_call()
+    uint16_t exec_hist[EVQ_HIST_BUCKETS];
+    uint16_t wait_hist[EVQ_HIST_BUCKETS];
+};
+
+struct equeue;
+
+/**
+ * Bytes free in an equeue buffer: what's left of the slab plus every chunk
+ * on the free lists. Each entry on chunks heads a list of free chunks of
+ * one size, linked through sibling. Takes the event type as a parameter
+ * so the host test can walk its lists without mbed.
+ */
+template <typename Event>
+size_t evq_free_bytes(size_t slab_size, const Event *chunks) {
+    size_t free_bytes = slab_size;
+
+    for (const Event *size = chunks; size; size = size->next) {
+        for (const Event *chunk = size; chunk; chunk = chunk->sibling) {
+            free_bytes += chunk->size;
+        }
+    }
+    return free_bytes;
+}
+
+/**
+ * Called by the equeue_alloc() wrap (APP_EVQ_WRAP_ALLOC) with the result
+ * of every allocation, on any queue and from any context
+ */
+typedef void (*evq_alloc_hook_t)(struct equeue *q, void *e);
+
+void evq_set_alloc_hook(evq_alloc_hook_t hook);
+
+/**
+ * Bookkeeping for ProfiledEventQueue, kept apart from mbed so it can be
+ * run on the host. The queue feeds it occupancy samples, failed posts
+ * and callback timings.
+ *
+ * A sample with less than event_size bytes free counts as full: no event
+ * fits, whether or not anyone tried to post one just then.
+ *
+ * Time a callback spends deliberately waiting, sleeping between uplinks
+ * or for a GPS fix, is reported with idle() and left out of its
+ * execution time: finished() takes the idle_ms() from when it started.
+ */
+class EvqStats {
+public:
+    EvqStats(size_t size, size_t event_size);
+
+    void sample(size_t used);
+    void post_failed(void);
+    void idle(uint32_t ms);
+    void finished(uint8_t slot, uint32_t wait, uint32_t elapsed, uint32_t idle_at_start);
+
+    size_t size(void) const;
+    size_t peak_used(void) const;
+    uint8_t peak_percent(void) const;
+    uint32_t post_failures(void) const;
+    uint32_t full_samples(void) const;
+    uint32_t idle_ms(void) const;
+    const evq_slot_stats_t &slot(uint8_t slot) const;
+
+    void dump(void) const;
+
+private:
+    size_t _size;
+    size_t _event_size;
+    size_t _peak_used;
+    uint32_t _post_failures;
+    uint32_t _full_samples;
+    uint32_t _idle_ms;
+    evq_slot_stats_t _slots[EVQ_PROFILE_SLOTS];
+};
@@ -0,0 +1,261 @@
+#include "fix_filter.h"
+
+#include <string.h>
+
+/**
+ * Filter gains in Q8. GPS noise is metres against kilometres of drift
+ * between fixes at float, so the gains are high to keep up with the wind.
+ * beta = alpha^2 / (2 - alpha), Benedict-Bordner.
+ */
+#define ALPHA_Q8            192     // 0.75
+#define BETA_Q8             115     // 0.45
+
+/**
+ * Metres per degree of latitude, and the largest lat/lon in 1e-6 deg
+ */
+#define METRES_PER_DEGREE   111195
+#define MAX_LAT             90000000
+#define MAX_LON             180000000
+
+/**
+ * cos() of whole degrees 0-90 in Q15
+ */
+static const int16_t cos_table[91] = {
+    32767, 32762, 32747, 32722, 32687, 32642, 32587, 32523, 32448, 32364,
+    32269, 32165, 32051, 31927, 31794, 31650, 31498, 31335, 31163, 30982,
+    30791, 30591, 30381, 30162, 29934, 29697, 29451, 29196, 28932, 28659,
+    28377, 28087, 27788, 27481, 27165, 26841, 26509, 26169, 25821, 25465,
+    25101, 24730, 24351, 23964, 23571, 23170, 22762, 22347, 21925, 21497,
+    21062, 20621, 20173, 19720, 19260, 18794, 18323, 17846, 17364, 16876,
+    16384, 15886, 15383, 14876, 14364, 13848, 13328, 12803, 12275, 11743,
+    11207, 10668, 10126, 9580, 9032, 8481, 7927, 7371, 6813, 6252,
+    5690, 5126, 4560, 3993, 3425, 2856, 2286, 1715, 1144, 572,
+    0
+};
+
+/**
+ * Limits for GPS fixes, anything outside them isn't worth an uplink
+ */
+const fix_filter_config_t fix_filter_default_config = {
+    500,    // max_hdop, 5.0
+    250,    // degraded_hdop, 2.5
+    4,      // min_sats
+    5000,   // max_age, ms
+    -100,   // min_altitude, m
+    45000,  // max_altitude, m
+    100,    // max_speed, m/s
+    60,     // max_vertical_speed, m/s, fast enough for a burst
+    1000,   // gate, m
+    900,    // max_coast, s
+    3600,   // track_timeout, s, a few missed fixes at float don't lose the velocity
+    3,      // max_gate_rejects
+    true    // substitute
+};
+
+static int64_t abs64(int64_t x) {
+    return x < 0 ? -x : x;
+}
+
+static uint32_t isqrt(uint64_t v) {
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while (bit > v)
+        bit >>= 2;
+    while (bit) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+/**
+ * Wrap a longitude difference into +-180 deg
+ */
+static int64_t wrap_lon(int64_t dlon) {
+    if (dlon > MAX_LON)
+        dlon -= 2 * (int64_t)MAX_LON;
+    else if (dlon < -MAX_LON)
+        dlon += 2 * (int64_t)MAX_LON;
+    return dlon;
+}
+
+/**
+ * Flat earth distance in metres, fine over the few tens of km between fixes
+ */
+static uint32_t distance(int32_t lat1, int32_t lon1, int32_t lat2, int32_t lon2) {
+    int64_t mid = abs64(((int64_t)lat1 + lat2) / 2) / 1000000;
+    int64_t dy = ((int64_t)lat2 - lat1) * METRES_PER_DEGREE / 1000000;
+    int64_t dx = wrap_lon((int64_t)lon2 - lon1) * METRES_PER_DEGREE * cos_table[mid > 90 ? 90 : mid];
+    dx = (dx >> 15) / 1000000;
+    return isqrt(dx * dx + dy * dy);
+}
+
+FixFilter::FixFilter(const fix_filter_config_t &config)
+    : _config(config)
+{
+    memset(_counts, 0, sizeof(_counts));
+    reset();
+}
+
+void FixFilter::reset(void) {
+    _have_track = false;
+    _have_velocity = false;
+    _gate_rejects = 0;
+    _time = 0;
+    _lat = _lon = 0;
+    _v_lat = _v_lon = 0;
+    _alt = _v_alt = 0;
+    _hdop = 0;
+    _sats = 0;
+}
+
+bool FixFilter::has_track(void) const {
+    return _have_track;
+}
+
+int32_t FixFilter::vertical_speed(void) const {
+    return _have_velocity ? _v_alt : 0;
+}
+
+bool FixFilter::has_vertical_speed(void) const {
+    return _have_velocity;
+}
+
+uint32_t FixFilter::count(fix_quality_t quality) const {
+    return _counts[quality];
+}
+
+/**
+ * Checks that don't need a track
+ */
+bool FixFilter::plausible(const gps_fix_t &fix) const {
+    if (fix.lat < -MAX_LAT || fix.lat > MAX_LAT || fix.lon < -MAX_LON || fix.lon > MAX_LON)
+        return false;
+    // Null island is what some receivers report before the first real fix
+    if (fix.lat == 0 && fix.lon == 0)
+        return false;
+    if (fix.altitude < _config.min_altitude || fix.altitude > _config.max_altitude)
+        return false;
+    if (fix.hdop == 0 || fix.hdop > _config.max_hdop)
+        return false;
+    if (fix.sats < _config.min_sats)
+        return false;
+    if (fix.age > _config.max_age)
+        return false;
+    return true;
+}
+
+void FixFilter::start_track(const gps_fix_t &fix, uint32_t now) {
+    _have_track = true;
+    _have_velocity = false;
+    _gate_rejects = 0;
+    _time = now;
+    _lat = fix.lat;
+    _lon = fix.lon;
+    _v_lat = _v_lon = 0;
+    _alt = fix.altitude * 100;
+    _v_alt = 0;
+    _hdop = fix.hdop;
+    _sats = fix.sats;
+}
+
+void FixFilter::predict(uint32_t dt, int32_t &lat, int32_t &lon, int32_t &alt) const {
+    int64_t p_lat = (int64_t)_lat + (int64_t)_v_lat * dt;
+    int64_t p_lon = _lon + wrap_lon((int64_t)_v_lon * dt);
+    int64_t p_alt = (int64_t)_alt + (int64_t)_v_alt * dt;
+
+    lat = p_lat > MAX_LAT ? MAX_LAT : p_lat < -MAX_LAT ? -MAX_LAT : p_lat;
+    lon = wrap_lon(p_lon);
+    alt = p_alt < (int64_t)_config.min_altitude * 100 ? _config.min_altitude * 100 : p_alt;
+}
+
+/**
+ * No usable measurement, send the prediction if we trust it
+ */
+fix_quality_t FixFilter::coast(uint32_t now, gps_fix_t &estimate) {
+    uint32_t dt = now - _time;
+
+    // A track from a single fix could be the glitch itself
+    if (!_config.substitute || !_have_velocity || dt > _config.max_coast) {
+        _counts[FIX_REJECTED]++;
+        return FIX_REJECTED;
+    }
+
+    predict(dt, estimate.lat, estimate.lon, estimate.altitude);
+    estimate.altitude /= 100;
+    estimate.hdop = _hdop;
+    estimate.sats = _sats;
+    estimate.age = dt * 1000;
+    _counts[FIX_ESTIMATED]++;
+    return FIX_ESTIMATED;
+}
+
+fix_quality_t FixFilter::update(const gps_fix_t &fix, uint32_t now, gps_fix_t &estimate) {
+    bool new_track = false;
+
+    if (!plausible(fix))
+        return coast(now, estimate);
+
+    if (!_have_track || now - _time > _config.track_timeout) {
+        start_track(fix, now);
+        new_track = true;
+    } else {
+        uint32_t dt = now - _time;
+        if (dt == 0)
+            dt = 1;
+
+        int32_t p_lat, p_lon, p_alt;
+        predict(dt, p_lat, p_lon, p_alt);
+
+        // How far the fix could reasonably be from where we expected
+        uint32_t moved = distance(p_lat, p_lon, fix.lat, fix.lon);
+        uint32_t climbed = abs64((int64_t)fix.altitude * 100 - p_alt) / 100;
+        bool outlier = moved > _config.gate + (uint32_t)_config.max_speed * dt
+                       || climbed > _config.gate + (uint32_t)_config.max_vertical_speed * dt;
+
+        if (outlier) {
+            // A run of outliers means the track was wrong, not the fixes
+            if (++_gate_rejects < _config.max_gate_rejects)
+                return coast(now, estimate);
+            start_track(fix, now);
+            new_track = true;
+        } else {
+            int64_t r_lat = (int64_t)fix.lat - p_lat;
+            int64_t r_lon = wrap_lon((int64_t)fix.lon - p_lon);
+            int64_t r_alt = (int64_t)fix.altitude * 100 - p_alt;
+
+            if (_have_velocity) {
+                _lat = p_lat + ((r_lat * ALPHA_Q8) >> 8);
+                _lon = wrap_lon(p_lon + ((r_lon * ALPHA_Q8) >> 8));
+                _alt = p_alt + ((r_alt * ALPHA_Q8) >> 8);
+                _v_lat += ((r_lat * BETA_Q8) >> 8) / dt;
+                _v_lon += ((r_lon * BETA_Q8) >> 8) / dt;
+                _v_alt += ((r_alt * BETA_Q8) >> 8) / dt;
+            } else {
+                // Two fixes give the velocity directly, the prediction had none
+                _lat = fix.lat;
+                _lon = fix.lon;
+                _alt = fix.altitude * 100;
+                _v_lat = r_lat / dt;
+                _v_lon = r_lon / dt;
+                _v_alt = r_alt / dt;
+                _have_velocity = true;
+            }
+            _time = now;
+            _hdop = fix.hdop;
+            _sats = fix.sats;
+            _gate_rejects = 0;
+        }
+    }
+
+    // Nothing has backed up the first fix of a track yet, it could be a glitch
+    estimate = fix;
+    fix_quality_t quality = (new_track || fix.hdop > _config.degraded_hdop) ? FIX_DEGRADED : FIX_GOOD;
+    _counts[quality]++;
+    return quality;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Fix quality sent with each uplink, 2 bits
+ */
+enum fix_quality_t {
+    FIX_REJECTED = 0,   // nothing usable, don't send a position
+    FIX_ESTIMATED = 1,  // measurement rejected, position is the filter's prediction
+    FIX_DEGRADED = 2,   // measurement accepted but marginal
+    FIX_GOOD = 3
+};
+
+/**
+ * A GPS fix, or the filter's estimate of one
+ */
+struct gps_fix_t {
+    int32_t lat;        // 1e-6 deg
+    int32_t lon;        // 1e-6 deg
+    int32_t altitude;   // m
+    uint16_t hdop;      // hundredths
+    uint8_t sats;
+    uint32_t age;       // ms since the fix was decoded
+};
+
+/**
+ * Limits a fix has to meet
+ */
+struct fix_filter_config_t {
+    uint16_t max_hdop;              // hundredths, anything above is rejected
+    uint16_t degraded_hdop;         // hundredths, anything above is marginal
+    uint8_t min_sats;
+    uint32_t max_age;               // ms
+    int32_t min_altitude;           // m
+    int32_t max_altitude;           // m
+    uint16_t max_speed;             // m/s horizontal
+    uint16_t max_vertical_speed;    // m/s
+    uint16_t gate;                  // m, allowed distance from the prediction on top of max speed
+    uint16_t max_coast;             // s, longest we'll send a prediction for
+    uint16_t track_timeout;         // s, gap between accepted fixes before the track is restarted
+    uint8_t max_gate_rejects;       // consecutive gate rejections before we restart the track
+    bool substitute;                // send the prediction instead of a rejected fix
+};
+
+/**
+ * Limits the firmware uses, shared with the host tests
+ */
+extern const fix_filter_config_t fix_filter_default_config;
+
+/**
+ * Alpha-beta tracking filter on position, altitude and vertical speed.
+ *
+ * All integer maths so it behaves the same on the host and on target.
+ * Each fix is checked against the limits and against the track so far;
+ * good fixes update the track, outliers are rejected and optionally
+ * replaced with the prediction. The first fix of a track is at best
+ * FIX_DEGRADED until a second one agrees with it. The second fix sets the
+ * velocity outright, the gains only have to follow changes after that.
+ */
+class FixFilter {
+public:
+    explicit FixFilter(const fix_filter_config_t &config);
+
+    fix_quality_t update(const gps_fix_t &fix, uint32_t now, gps_fix_t &estimate);
+    void reset(void);
+
+    int32_t vertical_speed(void) const; // cm/s
+    bool has_vertical_speed(void) const;
+    bool has_track(void) const;
+
+    uint32_t count(fix_quality_t quality) const;
+
+private:
+    bool plausible(const gps_fix_t &fix) const;
+    void start_track(const gps_fix_t &fix, uint32_t now);
+    void predict(uint32_t dt, int32_t &lat, int32_t &lon, int32_t &alt) const;
+    fix_quality_t coast(uint32_t now, gps_fix_t &estimate);
+
+    fix_filter_config_t _config;
+    bool _have_track;
+    bool _have_velocity;    // set by the second fix of a track
+    uint8_t _gate_rejects;
+    uint32_t _time;         // s, last update
+    int32_t _lat;           // 1e-6 deg
+    int32_t _lon;
+    int32_t _v_lat;         // 1e-6 deg/s
+    int32_t _v_lon;
+    int32_t _alt;           // cm
+    int32_t _v_alt;         // cm/s
+    uint16_t _hdop;
+    uint8_t _sats;
+    uint32_t _counts[4];
+};
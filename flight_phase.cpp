@@ -0,0 +1,208 @@
+#include "flight_phase.h"
+
+/**
+ * Atmosphere scale height, dh = -H * dP / P
+ */
+#define SCALE_HEIGHT_CM     740000
+
+/**
+ * Time constant for smoothing the pressure derived vertical speed. The
+ * weight of a new reading is dt / (dt + tau), so the 10 minute samples
+ * at float aren't smoothed on top of the averaging they already have.
+ */
+#define BARO_TAU_S          60
+
+/**
+ * Anything outside this isn't a real BMP280 reading
+ */
+#define MIN_PRESSURE        300
+#define MAX_PRESSURE        110000
+
+const flight_phase_config_t flight_phase_default_config = {
+    60,     // climb, cm/s
+    60,     // sink, cm/s
+    30,     // float_band, cm/s
+    300,    // fast_sink, cm/s, only a burst or a failing balloon sinks this fast
+    1800,   // launch_time, s
+    3000,   // landed_altitude, m
+    70000,  // landed_pressure, Pa, about 3000 m
+    60      // confirm_time, s
+};
+
+/**
+ * Uplinks are dense while a recovery team might be watching, and sparse at
+ * float where the balloon can be up for weeks
+ */
+const phase_policy_t phase_policies[PHASE_COUNT] = {
+    // tx_interval s, gps_window s, keyframes
+    {120, 30, false},   // PHASE_GROUND
+    {60, 20, true},     // PHASE_LAUNCH
+    {120, 30, false},   // PHASE_ASCENT
+    {600, 60, false},   // PHASE_FLOAT
+    {60, 20, true}      // PHASE_DESCENT
+};
+
+static const char *const phase_names[PHASE_COUNT] = {
+    "ground", "launch", "ascent", "float", "descent"
+};
+
+const char *flight_phase_name(flight_phase_t phase) {
+    return phase < PHASE_COUNT ? phase_names[phase] : "unknown";
+}
+
+uint16_t flight_tx_interval(const FlightPhase &phase) {
+    uint16_t interval = phase_policies[phase.phase()].tx_interval;
+    if (phase.pending() && phase_policies[phase.candidate()].tx_interval < interval)
+        interval = phase_policies[phase.candidate()].tx_interval;
+    return interval;
+}
+
+FlightPhase::FlightPhase(const flight_phase_config_t &config)
+    : _config(config)
+{
+    reset();
+}
+
+void FlightPhase::reset(void) {
+    _phase = PHASE_GROUND;
+    _candidate = PHASE_GROUND;
+    _candidate_time = 0;
+    _started = false;
+    _launch_time = 0;
+    _have_pressure = false;
+    _pressure = 0;
+    _pressure_time = 0;
+    _have_baro_speed = false;
+    _baro_speed = 0;
+    _have_speed = false;
+    _speed = 0;
+}
+
+flight_phase_t FlightPhase::phase(void) const {
+    return _phase;
+}
+
+flight_phase_t FlightPhase::candidate(void) const {
+    return _candidate;
+}
+
+bool FlightPhase::pending(void) const {
+    return _candidate != _phase;
+}
+
+int32_t FlightPhase::vertical_speed(void) const {
+    return _have_speed ? _speed : 0;
+}
+
+bool FlightPhase::has_vertical_speed(void) const {
+    return _have_speed;
+}
+
+bool FlightPhase::baro_vertical_speed(const flight_sample_t &sample, int32_t &speed) {
+    if (sample.pressure < MIN_PRESSURE || sample.pressure > MAX_PRESSURE) {
+        _have_pressure = false;
+        _have_baro_speed = false;
+        return false;
+    }
+
+    if (_have_pressure && sample.time > _pressure_time) {
+        uint32_t dt = sample.time - _pressure_time;
+        int64_t dp = (int64_t)sample.pressure - _pressure;
+        int32_t raw = -dp * SCALE_HEIGHT_CM / ((int64_t)sample.pressure * dt);
+        if (_have_baro_speed)
+            _baro_speed += (int64_t)(raw - _baro_speed) * dt / (dt + BARO_TAU_S);
+        else
+            _baro_speed = raw;
+        _have_baro_speed = true;
+    }
+
+    _have_pressure = true;
+    _pressure = sample.pressure;
+    _pressure_time = sample.time;
+    speed = _baro_speed;
+    return _have_baro_speed;
+}
+
+bool FlightPhase::is_low(const flight_sample_t &sample) const {
+    if (sample.has_altitude)
+        return sample.altitude < _config.landed_altitude;
+    return sample.pressure > _config.landed_pressure;
+}
+
+flight_phase_t FlightPhase::classify(int32_t speed, bool low, uint32_t now) const {
+    bool climbing = speed > _config.climb;
+    bool sinking = speed < -_config.sink;
+    bool level = speed <= _config.float_band && speed >= -_config.float_band;
+
+    switch (_phase) {
+        case PHASE_GROUND:
+            return climbing ? PHASE_LAUNCH : PHASE_GROUND;
+        case PHASE_LAUNCH:
+            if (sinking)
+                return PHASE_DESCENT;
+            if (now - _launch_time < _config.launch_time)
+                return PHASE_LAUNCH;
+            return level ? PHASE_FLOAT : PHASE_ASCENT;
+        case PHASE_ASCENT:
+            if (sinking)
+                return PHASE_DESCENT;
+            return level ? PHASE_FLOAT : PHASE_ASCENT;
+        case PHASE_FLOAT:
+            if (sinking)
+                return PHASE_DESCENT;
+            return climbing ? PHASE_ASCENT : PHASE_FLOAT;
+        case PHASE_DESCENT:
+            if (climbing)
+                return PHASE_ASCENT;
+            if (level)
+                return low ? PHASE_GROUND : PHASE_FLOAT;
+            return PHASE_DESCENT;
+        default:
+            return _phase;
+    }
+}
+
+flight_phase_t FlightPhase::update(const flight_sample_t &sample) {
+    int32_t baro_speed;
+    bool have_baro = baro_vertical_speed(sample, baro_speed);
+    bool have_altitude = sample.has_altitude || _have_pressure;
+
+    if (have_baro && sample.has_vertical_speed) {
+        _speed = (baro_speed + sample.vertical_speed) / 2;
+    } else if (have_baro) {
+        _speed = baro_speed;
+    } else if (sample.has_vertical_speed) {
+        _speed = sample.vertical_speed;
+    }
+    _have_speed = have_baro || sample.has_vertical_speed;
+
+    if (!_started) {
+        if (!have_altitude)
+            return _phase;
+        _started = true;
+        _phase = _candidate = is_low(sample) ? PHASE_GROUND : PHASE_FLOAT;
+        return _phase;
+    }
+
+    if (!_have_speed)
+        return _phase;
+
+    flight_phase_t next = classify(_speed, have_altitude && is_low(sample), sample.time);
+    if (next == _phase) {
+        _candidate = _phase;
+        return _phase;
+    }
+    if (next != _candidate) {
+        _candidate = next;
+        _candidate_time = sample.time;
+    }
+    bool fast_sink = next == PHASE_DESCENT && _speed < -_config.fast_sink;
+    if (!fast_sink && sample.time - _candidate_time < _config.confirm_time)
+        return _phase;
+
+    // Launch time counts from the first climbing sample, not the confirmation
+    if (next == PHASE_LAUNCH)
+        _launch_time = _candidate_time;
+    _phase = next;
+    return _phase;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+
+enum flight_phase_t {
+    PHASE_GROUND = 0,
+    PHASE_LAUNCH,       // first few minutes of the climb
+    PHASE_ASCENT,
+    PHASE_FLOAT,
+    PHASE_DESCENT,
+    PHASE_COUNT
+};
+
+/**
+ * One set of readings, taken once per cycle
+ */
+struct flight_sample_t {
+    uint32_t time;          // s
+    uint32_t pressure;      // Pa, 0 if not read
+    bool has_altitude;
+    int32_t altitude;       // m, GPS
+    bool has_vertical_speed;
+    int32_t vertical_speed; // cm/s, from the fix filter
+};
+
+/**
+ * Thresholds for changing phase. Vertical speeds between float_band and
+ * climb/sink leave the phase as it is.
+ */
+struct flight_phase_config_t {
+    int16_t climb;              // cm/s, faster than this is climbing
+    int16_t sink;               // cm/s, sinking faster than this is descending
+    int16_t float_band;         // cm/s, slower than this either way is level
+    int16_t fast_sink;          // cm/s, sinking faster than this is descending at once
+    uint16_t launch_time;       // s, how long after leaving the ground we're in PHASE_LAUNCH
+    int32_t landed_altitude;    // m, level below this is on the ground
+    uint32_t landed_pressure;   // Pa, the same for when there's no GPS altitude
+    uint16_t confirm_time;      // s, how long a new phase has to be seen before it's taken
+};
+
+/**
+ * What to do in each phase
+ */
+struct phase_policy_t {
+    uint16_t tx_interval;   // s
+    uint16_t gps_window;    // s, longest we wait for a fix
+    bool keyframes;         // send every uplink as a keyframe
+};
+
+/**
+ * Thresholds and per phase policies the firmware uses, shared with the
+ * host tests
+ */
+extern const flight_phase_config_t flight_phase_default_config;
+extern const phase_policy_t phase_policies[PHASE_COUNT];
+
+/**
+ * Works out the flight phase from the vertical speed.
+ *
+ * Vertical speed comes from the pressure trend and from the fix filter,
+ * averaged when we have both. A new phase has to be seen for
+ * `confirm_time` before it's taken, which needs a second sample. Sinking
+ * faster than `fast_sink` is taken as DESCENT on the first sample, as a
+ * burst at float would otherwise go unreported for a whole float interval.
+ * The first sample with an altitude picks GROUND or FLOAT, so a reset in
+ * flight doesn't look like a launch.
+ */
+class FlightPhase {
+public:
+    explicit FlightPhase(const flight_phase_config_t &config);
+
+    flight_phase_t update(const flight_sample_t &sample);
+    void reset(void);
+
+    flight_phase_t phase(void) const;
+    flight_phase_t candidate(void) const;
+    bool pending(void) const;           // a new phase is waiting to be confirmed
+    int32_t vertical_speed(void) const; // cm/s
+    bool has_vertical_speed(void) const;
+
+private:
+    bool baro_vertical_speed(const flight_sample_t &sample, int32_t &speed);
+    bool is_low(const flight_sample_t &sample) const;
+    flight_phase_t classify(int32_t speed, bool low, uint32_t now) const;
+
+    flight_phase_config_t _config;
+    flight_phase_t _phase;
+    flight_phase_t _candidate;
+    uint32_t _candidate_time;   // s, first sample in the candidate phase
+    bool _started;
+    uint32_t _launch_time;      // s
+    bool _have_pressure;
+    uint32_t _pressure;         // Pa, last reading
+    uint32_t _pressure_time;    // s
+    bool _have_baro_speed;
+    int32_t _baro_speed;        // cm/s, smoothed
+    bool _have_speed;
+    int32_t _speed;             // cm/s
+};
+
+const char *flight_phase_name(flight_phase_t phase);
+
+/**
+ * Seconds until the next uplink: the phase's interval, or the candidate
+ * phase's while it's pending if that's shorter, so it's confirmed sooner
+ */
+uint16_t flight_tx_interval(const FlightPhase &phase);
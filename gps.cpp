@@ -9,7 +9,7 @@
  * GPS Setup
  */
 
-static BufferedSerial gps(PB_6, PB_7, 9600);
+static BufferedSerial gps(Board::gps_tx, Board::gps_rx, Board::gps_baud);
 TinyGPSPlus gps_parser;
 
 char buf[100] = {0};
@@ -20,6 +20,7 @@ uint8_t error_counter = 0;
 bool first_boot = true;
 bool need_longer_sleep = false;
 uint32_t last_fix_count = 0;
+uint16_t gps_wait_s = GPS_WAIT_S;
 
 bool get_need_longer_sleep(void) {
     return need_longer_sleep;
@@ -31,6 +32,10 @@ void set_need_longer_sleep(bool set_bool) {
         error_counter = 0;
 }
 
+void set_gps_wait(uint16_t seconds) {
+    gps_wait_s = seconds;
+}
+
 void gps_time(char* buffer, uint8_t size) {
     printf(buffer, size, "%02d:%02d:%02d", gps_parser.time.hour(), gps_parser.time.minute(), gps_parser.time.second());
 }
@@ -54,13 +59,13 @@ void gps_loop(void) {
     gps.enable_input(true);
     gps.enable_output(true);
     time_t seconds = time(NULL);
+    // The longer wait is for a cold start and every third failed fix, not a fix last time
+    time_t wait = (first_boot || (error_counter && error_counter % 3 == 0)) ? GPS_ERROR_WAIT_S : gps_wait_s;
     while (true) {
         gps_read();
 
         time_t now = time(NULL);
-        if (((now - seconds) > GPS_WAIT_S) && !first_boot && (error_counter % 3 != 0)) {
-            break;
-        } else if (((now - seconds) > GPS_ERROR_WAIT_S) && (first_boot || (error_counter % 3 == 0))) {
+        if ((now - seconds) > wait) {
             break;
         } else if ((gps_parser.sentencesWithFix() - last_fix_count > 10) && gps_parser.satellites.value() > 3) {
             break;
@@ -167,6 +172,18 @@ void exit_gps_standby(void) {
     gps.write(WAKEUP_STRING, sizeof(WAKEUP_STRING));
 }
 
+// For boards that can't switch the GPS off, output is off outside gps_loop()
+void set_gps_standby(bool standby) {
+    gps.enable_output(true);
+    if (standby) {
+        enter_gps_standby();
+    } else {
+        exit_gps_standby();
+    }
+    gps.sync();
+    gps.enable_output(false);
+}
+
 // Can only really be used once per transmission loop
 bool is_fix_valid(void) {
     uint32_t now_fix_count;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <TinyGPS++.h>
+#include "board_profile.h"
 
 extern TinyGPSPlus gps_parser;
 extern bool ack_rec;
@@ -15,7 +16,33 @@ bool enter_gps_standby(void);
 void exit_gps_standby(void);
 bool get_need_longer_sleep(void);
 void set_need_longer_sleep(bool set_bool);
+void set_gps_wait(uint16_t seconds);
 bool is_fix_valid(void);
+void set_gps_standby(bool standby);
+
+/**
+ * Turns the GPS off between fixes in whichever way the board supports
+ */
+template <gps_power_t Style>
+class GpsPower {
+public:
+    explicit GpsPower(PinName pin) : _switch(pin) {}
+    void write(int on) {
+        _switch.write(on);
+    }
+
+private:
+    DigitalOut _switch;
+};
+
+template <>
+class GpsPower<GPS_POWER_STANDBY> {
+public:
+    explicit GpsPower(PinName pin) {}
+    void write(int on) {
+        set_gps_standby(!on);
+    }
+};
 
 // PMTK strings
 #define STANDBY_STRING "$PMTK161,0*28\r\n"
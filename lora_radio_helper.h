@@ -19,68 +19,16 @@
 #define APP_LORA_RADIO_HELPER_H_
 
 #include "lorawan/LoRaRadio.h"
+#include "board_profile.h"
 
-#if COMPONENT_SX1272
-#include "SX1272_LoRaRadio.h"
-SX1272_LoRaRadio radio(MBED_CONF_SX1272_LORA_DRIVER_SPI_MOSI,
-                       MBED_CONF_SX1272_LORA_DRIVER_SPI_MISO,
-                       MBED_CONF_SX1272_LORA_DRIVER_SPI_SCLK,
-                       MBED_CONF_SX1272_LORA_DRIVER_SPI_CS,
-                       MBED_CONF_SX1272_LORA_DRIVER_RESET,
-                       MBED_CONF_SX1272_LORA_DRIVER_DIO0,
-                       MBED_CONF_SX1272_LORA_DRIVER_DIO1,
-                       MBED_CONF_SX1272_LORA_DRIVER_DIO2,
-                       MBED_CONF_SX1272_LORA_DRIVER_DIO3,
-                       MBED_CONF_SX1272_LORA_DRIVER_DIO4,
-                       MBED_CONF_SX1272_LORA_DRIVER_DIO5,
-                       MBED_CONF_SX1272_LORA_DRIVER_RF_SWITCH_CTL1,
-                       MBED_CONF_SX1272_LORA_DRIVER_RF_SWITCH_CTL2,
-                       MBED_CONF_SX1272_LORA_DRIVER_TXCTL,
-                       MBED_CONF_SX1272_LORA_DRIVER_RXCTL,
-                       MBED_CONF_SX1272_LORA_DRIVER_ANT_SWITCH,
-                       MBED_CONF_SX1272_LORA_DRIVER_PWR_AMP_CTL,
-                       MBED_CONF_SX1272_LORA_DRIVER_TCXO);
-
-#elif COMPONENT_SX1276
-#include "SX1276_LoRaRadio.h"
-SX1276_LoRaRadio radio(MBED_CONF_SX1276_LORA_DRIVER_SPI_MOSI,
-                       MBED_CONF_SX1276_LORA_DRIVER_SPI_MISO,
-                       MBED_CONF_SX1276_LORA_DRIVER_SPI_SCLK,
-                       MBED_CONF_SX1276_LORA_DRIVER_SPI_CS,
-                       MBED_CONF_SX1276_LORA_DRIVER_RESET,
-                       MBED_CONF_SX1276_LORA_DRIVER_DIO0,
-                       MBED_CONF_SX1276_LORA_DRIVER_DIO1,
-                       MBED_CONF_SX1276_LORA_DRIVER_DIO2,
-                       MBED_CONF_SX1276_LORA_DRIVER_DIO3,
-                       MBED_CONF_SX1276_LORA_DRIVER_DIO4,
-                       MBED_CONF_SX1276_LORA_DRIVER_DIO5,
-                       MBED_CONF_SX1276_LORA_DRIVER_RF_SWITCH_CTL1,
-                       MBED_CONF_SX1276_LORA_DRIVER_RF_SWITCH_CTL2,
-                       MBED_CONF_SX1276_LORA_DRIVER_TXCTL,
-                       MBED_CONF_SX1276_LORA_DRIVER_RXCTL,
-                       MBED_CONF_SX1276_LORA_DRIVER_ANT_SWITCH,
-                       MBED_CONF_SX1276_LORA_DRIVER_PWR_AMP_CTL,
-                       MBED_CONF_SX1276_LORA_DRIVER_TCXO);
-
-#elif COMPONENT_SX126X
-#include "SX126X_LoRaRadio.h"
-SX126X_LoRaRadio radio(MBED_CONF_SX126X_LORA_DRIVER_SPI_MOSI,
-                       MBED_CONF_SX126X_LORA_DRIVER_SPI_MISO,
-                       MBED_CONF_SX126X_LORA_DRIVER_SPI_SCLK,
-                       MBED_CONF_SX126X_LORA_DRIVER_SPI_CS,
-                       MBED_CONF_SX126X_LORA_DRIVER_RESET,
-                       MBED_CONF_SX126X_LORA_DRIVER_DIO1,
-                       MBED_CONF_SX126X_LORA_DRIVER_BUSY,
-                       MBED_CONF_SX126X_LORA_DRIVER_FREQ_SELECT,
-                       MBED_CONF_SX126X_LORA_DRIVER_DEVICE_SELECT,
-                       MBED_CONF_SX126X_LORA_DRIVER_CRYSTAL_SELECT,
-                       MBED_CONF_SX126X_LORA_DRIVER_ANT_SWITCH);
-
-#elif (TARGET_STM32WL)
+#if (TARGET_STM32WL)
 #include "STM32WL_LoRaRadio.h"
+#define APP_LORA_RADIO RADIO_STM32WL
 STM32WL_LoRaRadio radio;
 #else
-#error "Unknown LoRa radio specified (SX126X, SX1272, SX1276, STM32WL are valid)"
+#error "No board profile for this target's radio, see board_profile.h and custom_targets.json"
 #endif
 
+static_assert(Board::radio == APP_LORA_RADIO, "Board profile radio doesn't match the radio driver for this target");
+
 #endif /* APP_LORA_RADIO_HELPER_H_ */
@@ -15,18 +15,31 @@
  * limitations under the License.
  */
 #include <stdio.h>
+#include <new>
 
 #include "mbed.h"
 #include "mbed_stats.h"
 #include "lorawan/LoRaWANInterface.h"
 #include "lorawan/system/lorawan_data_structures.h"
 #include "events/EventQueue.h"
+#include "lorastack/phy/LoRaPHYEU868.h"
+#include "lorastack/phy/LoRaPHYUS915.h"
+#include "lorastack/phy/LoRaPHYAU915.h"
+#include "lorastack/phy/LoRaPHYAS923.h"
+#include "lorastack/phy/LoRaPHYIN865.h"
+#include "lorastack/phy/LoRaPHYKR920.h"
 
 // Application helpers
 #include "trace_helper.h"
 #include "lora_radio_helper.h"
 #include "gps.h"
-#include "BMP280.h"
+#include "payload.h"
+#include "region.h"
+#include "aes_backend.h"
+#include "fix_filter.h"
+#include "evq_profiler.h"
+#include "flight_phase.h"
+#include "sensors.h"
 
 using namespace events;
 
@@ -37,9 +50,9 @@ uint8_t tx_buffer[30];
 uint8_t rx_buffer[30];
 
 /*
- * Sets up an application dependent transmission timer in ms. Used only when Duty Cycling is off for testing
+ * Transmission interval while the GPS is struggling, and after a failed join.
+ * Otherwise the interval comes from the flight phase policy.
  */
-#define TX_TIMER                        60s
 #define SLOW_TX_TIMER                   300s
 
 /**
@@ -55,10 +68,48 @@ uint8_t rx_buffer[30];
 #define CONFIRMED_MSG_RETRY_COUNTER     3
 
 /**
- * Port for different types of message
+ * Send a full keyframe at least this often so the ground can resynchronise
  */
-#define GPS_PORT    2
-#define STATUS_PORT 3
+#define PAYLOAD_KEYFRAME_INTERVAL       10
+
+/**
+ * Precision of the delta payload fields, see payload_precision_t
+ */
+#define PAYLOAD_ALTITUDE_STEP           5
+#define PAYLOAD_PRESSURE_STEP           10
+#define PAYLOAD_TEMP_STEP               2
+#define PAYLOAD_BATTERY_STEP            2
+#define PAYLOAD_COARSE_POSITION_ABOVE   8000
+
+/**
+ * Frequency plan used until we get a fix, should match lora.phy in mbed_app.json
+ */
+#define DEFAULT_REGION                  REGION_EU868
+
+/**
+ * Number of consecutive fixes in a new region before switching frequency plan
+ */
+#define REGION_SWITCH_FIXES             2
+
+/**
+ * GPS windows at boot to get a fix the filter backs up with a second one,
+ * enough to get past a glitched first fix, before falling back to
+ * DEFAULT_REGION
+ */
+#define BOOT_REGION_WINDOWS             5
+
+/**
+ * Profiler slots for the event queue. LoRaWAN stack events use their
+ * lorawan_event_t value after the application's own events.
+ */
+#define EVQ_SLOT_SKIP_CYCLE             0
+#define EVQ_SLOT_SWITCH_REGION          1
+#define EVQ_SLOT_LORA_EVENT             2
+
+/**
+ * A downlink on this port prints the event queue profile
+ */
+#define EVQ_DUMP_PORT                   10
 
 /**
 * This event queue is the global event queue for both the
@@ -67,7 +118,7 @@ uint8_t rx_buffer[30];
 * providing an event queue to the stack that will be used for ISR deferment as
 * well as application information event queuing.
 */
-static EventQueue lora_ev_queue(MAX_NUMBER_OF_EVENTS *EVENTS_EVENT_SIZE);
+static ProfiledEventQueue lora_ev_queue(MAX_NUMBER_OF_EVENTS *EVENTS_EVENT_SIZE);
 
 /**
  * Event handler.
@@ -77,10 +128,47 @@ static EventQueue lora_ev_queue(MAX_NUMBER_OF_EVENTS *EVENTS_EVENT_SIZE);
  */
 static void lora_event_handler(lorawan_event_t event);
 
+static void profiled_lora_event_handler(lorawan_event_t event) {
+    lora_ev_queue.profile(EVQ_SLOT_LORA_EVENT + event, [event]() {
+        lora_event_handler(event);
+    });
+}
+
+/**
+ * Wait for the next cycle without transmitting
+ */
+static void skip_cycle(void);
+
+static bool read_gps(telemetry_t &t);
+
 /**
- * Constructing Mbed LoRaWANInterface and passing it the radio object from lora_radio_helper.
+ * Storage for the PHY of the current region. Only one is alive at a time,
+ * it's rebuilt when the balloon crosses into another region.
  */
-static LoRaWANInterface lorawan(radio);
+union phy_storage_t {
+    phy_storage_t() {}
+    ~phy_storage_t() {}
+    LoRaPHYEU868 eu868;
+    LoRaPHYUS915 us915;
+    LoRaPHYAU915 au915;
+    LoRaPHYAS923 as923;
+    LoRaPHYIN865 in865;
+    LoRaPHYKR920 kr920;
+};
+static phy_storage_t phy_storage;
+static LoRaPHY *phy = NULL;
+
+/**
+ * Mbed LoRaWANInterface, constructed with the radio object from lora_radio_helper
+ * and the PHY for the current region. NULL while transmission is suppressed.
+ */
+alignas(LoRaWANInterface) static uint8_t lorawan_storage[sizeof(LoRaWANInterface)];
+static LoRaWANInterface *lorawan = NULL;
+
+static lora_region_t current_region = REGION_UNKNOWN;
+static lora_region_t pending_region = REGION_UNKNOWN;
+static lora_region_t candidate_region = REGION_UNKNOWN;
+static uint8_t candidate_fixes = 0;
 
 /**
  * Application specific callbacks
@@ -88,129 +176,209 @@ static LoRaWANInterface lorawan(radio);
 static lorawan_app_callbacks_t callbacks;
 
 /**
- * Pin to control power to GPS
+ * Keeps track of what the ground has already seen
  */
-DigitalOut p_vcc(PB_5);
+static const payload_precision_t payload_precision = {
+    PAYLOAD_ALTITUDE_STEP,
+    PAYLOAD_PRESSURE_STEP,
+    PAYLOAD_TEMP_STEP,
+    PAYLOAD_BATTERY_STEP,
+    PAYLOAD_COARSE_POSITION_ABOVE
+};
+static PayloadEncoder payload_encoder(PAYLOAD_KEYFRAME_INTERVAL, payload_precision);
+
+static FixFilter fix_filter(fix_filter_default_config);
+
+static FlightPhase flight_phase(flight_phase_default_config);
 
 /**
- * ADC Pin to measure battery voltage
+ * Control power to GPS
  */
-AnalogIn voltage(PB_3);
+GpsPower<Board::gps_power_style> p_vcc(Board::gps_power);
 
 /**
- * Store Lat & Long in six bytes of payload
+ * Maximum number of threads looked at for stack stats
  */
-void pack_lat_lon(double lat, double lon) {
-  uint32_t LatitudeBinary;
-  uint32_t LongitudeBinary;
-  LatitudeBinary = ((lat + 90) / 180.0) * 16777215;
-  LongitudeBinary = ((lon + 180) / 360.0) * 16777215;
-
-  tx_buffer[0] = (LatitudeBinary >> 16) & 0xFF;
-  tx_buffer[1] = (LatitudeBinary >> 8) & 0xFF;
-  tx_buffer[2] = LatitudeBinary & 0xFF;
-  tx_buffer[3] = (LongitudeBinary >> 16) & 0xFF;
-  tx_buffer[4] = (LongitudeBinary >> 8) & 0xFF;
-  tx_buffer[5] = LongitudeBinary & 0xFF;
-}
+#define MAX_THREAD_STATS                8
 
 /**
- * Store BMP280 data in 5 bytes of payload
+ * Read the main thread stack and heap high-water marks into the telemetry
  */
-void packBMP280Stuff(bool gps_packet) {
-    float raw_temp;
-    uint16_t temp;
-    uint32_t pressure;
+void read_mem_stats(telemetry_t &t) {
+#if MBED_CONF_APP_REPORT_MEM_STATS
+    mbed_stats_stack_t stack_stats[MAX_THREAD_STATS];
+    mbed_stats_heap_t heap_stats;
+    uint32_t main_id = (uint32_t)ThisThread::get_id();
+    size_t count;
+
+    t.has_mem_stats = true;
+
+    // Everything, stack included, runs from the event queue in the main thread
+    count = mbed_stats_stack_get_each(stack_stats, MAX_THREAD_STATS);
+    for (size_t i = 0; i < count; i++) {
+        if (stack_stats[i].thread_id == main_id) {
+            t.stack_max = stack_stats[i].max_size > 0xFFFF ? 0xFFFF : stack_stats[i].max_size;
+        }
+    }
 
-    sleep_manager_lock_deep_sleep();
+    mbed_stats_heap_get(&heap_stats);
+    t.heap_max = heap_stats.max_size > 0xFFFF ? 0xFFFF : heap_stats.max_size;
 
-    /**
-     * BMP280 I2C
-     */
-    BMP280 bmp280(PA_11, PA_12, 0x76);
-    bmp280.initialize();
-    
-    raw_temp = bmp280.getTemperature();
-    pressure = bmp280.getPressure();
-    
-    temp = int(raw_temp * 10 + 0.5) + 128; // Encode the temperature to avoid negatives.
-    if (gps_packet) {
-        tx_buffer[11] = (pressure >> 16) & 0xFF;
-        tx_buffer[12] = (pressure >> 8) & 0xFF;
-        tx_buffer[13] = pressure & 0xFF;
-
-        tx_buffer[14] = (temp >> 8) & 0xFF;
-        tx_buffer[15] = temp & 0xFF;
-    } else {
-        tx_buffer[1] = (pressure >> 16) & 0xFF;
-        tx_buffer[2] = (pressure >> 8) & 0xFF;
-        tx_buffer[3] = pressure & 0xFF;
+#if MBED_CONF_APP_EVQ_PROFILE
+    t.has_evq_stats = true;
+    t.evq_peak = lora_ev_queue.peak_percent();
+    t.evq_failures = lora_ev_queue.post_failures() > 0xFF ? 0xFF : lora_ev_queue.post_failures();
+#endif
+#endif
+}
+
+/**
+ * Build the PHY for a region in phy_storage
+ */
+static LoRaPHY *create_phy(lora_region_t region) {
+    switch (region) {
+        case REGION_US915:
+            return new (&phy_storage.us915) LoRaPHYUS915();
+        case REGION_AU915:
+            return new (&phy_storage.au915) LoRaPHYAU915();
+        case REGION_AS923:
+            return new (&phy_storage.as923) LoRaPHYAS923();
+        case REGION_IN865:
+            return new (&phy_storage.in865) LoRaPHYIN865();
+        case REGION_KR920:
+            return new (&phy_storage.kr920) LoRaPHYKR920();
+        default:
+            return new (&phy_storage.eu868) LoRaPHYEU868();
+    }
+}
 
-        tx_buffer[4] = (temp >> 8) & 0xFF;
-        tx_buffer[5] = temp & 0xFF;
+/**
+ * Tear down the LoRaWAN stack if it's running
+ */
+static void stop_lorawan() {
+    if (lorawan) {
+        lorawan->~LoRaWANInterface();
+        lorawan = NULL;
+    }
+    if (phy) {
+        phy->~LoRaPHY();
+        phy = NULL;
     }
-    bmp280.deInit();
-    sleep_manager_unlock_deep_sleep();
 }
 
 /**
- * Entry point for application
+ * Bring up the LoRaWAN stack with the PHY for a region and start joining.
+ * Sessions don't carry over between frequency plans so we always rejoin.
  */
-int main(void)
-{
-    sleep_manager_lock_deep_sleep();
+static bool start_lorawan(lora_region_t region) {
+    // stores the status of a call to LoRaWAN protocol
+    lorawan_status_t retcode;
 
-    mbed_file_handle(STDIN_FILENO)->enable_input(true);
-    mbed_file_handle(STDOUT_FILENO)->enable_output(true);
-    // setup tracing
-    setup_trace();
+    stop_lorawan();
+    phy = create_phy(region);
+    lorawan = new (lorawan_storage) LoRaWANInterface(radio, *phy);
+    current_region = region;
 
-    // Turn on GPS
-    p_vcc.write(1);
+    // The new network hasn't seen anything yet
+    payload_encoder.force_keyframe();
 
-    // stores the status of a call to LoRaWAN protocol
-    lorawan_status_t retcode;
+    printf("\r\n Using %s frequency plan \r\n", region_name(region));
 
     // Initialize LoRaWAN stack
-    if (lorawan.initialize(&lora_ev_queue) != LORAWAN_STATUS_OK) {
+    if (lorawan->initialize(&lora_ev_queue) != LORAWAN_STATUS_OK) {
         printf("\r\n LoRa initialization failed! \r\n");
-        return -1;
+        return false;
     }
 
     printf("\r\n Mbed LoRaWANStack initialized \r\n");
 
     // prepare application callbacks
-    callbacks.events = mbed::callback(lora_event_handler);
-    lorawan.add_app_callbacks(&callbacks);
+    callbacks.events = mbed::callback(profiled_lora_event_handler);
+    lorawan->add_app_callbacks(&callbacks);
 
     // Set number of retries in case of CONFIRMED messages
-    if (lorawan.set_confirmed_msg_retries(CONFIRMED_MSG_RETRY_COUNTER)
+    if (lorawan->set_confirmed_msg_retries(CONFIRMED_MSG_RETRY_COUNTER)
             != LORAWAN_STATUS_OK) {
         printf("\r\n set_confirmed_msg_retries failed! \r\n\r\n");
-        return -1;
+        return false;
     }
 
     printf("\r\n CONFIRMED message retries : %d \r\n",
            CONFIRMED_MSG_RETRY_COUNTER);
 
     // Enable adaptive data rate
-    if (lorawan.disable_adaptive_datarate() != LORAWAN_STATUS_OK) {
+    if (lorawan->disable_adaptive_datarate() != LORAWAN_STATUS_OK) {
         printf("\r\n disable_adaptive_datarate failed! \r\n");
-        return -1;
+        return false;
     }
 
     printf("\r\n Adaptive data rate (ADR) - Disabled \r\n");
 
-    retcode = lorawan.connect();
+    retcode = lorawan->connect();
 
     if (retcode == LORAWAN_STATUS_OK ||
             retcode == LORAWAN_STATUS_CONNECT_IN_PROGRESS) {
     } else {
         printf("\r\n Connection error, code = %d \r\n", retcode);
-        return -1;
+        return false;
     }
 
     printf("\r\n Connection - In Progress ...\r\n");
+    return true;
+}
+
+/**
+ * Entry point for application
+ */
+int main(void)
+{
+    sleep_manager_lock_deep_sleep();
+
+    mbed_file_handle(STDIN_FILENO)->enable_input(true);
+    mbed_file_handle(STDOUT_FILENO)->enable_output(true);
+    // setup tracing
+    setup_trace();
+
+    // Turn on GPS
+    p_vcc.write(1);
+
+    // Don't join with a crypto backend that gets the wrong answers. The
+    // hardware backend has already fallen back to software, so a reset is
+    // the only thing left to try.
+    if (!aes_backend_self_test()) {
+        printf("\r\n AES self-test failed, resetting \r\n");
+        ThisThread::sleep_for(1s);
+        system_reset();
+    }
+
+    // Get a fix before joining so we use the right frequency plan. The
+    // filter only calls a fix good once a second one agrees with it, so
+    // a single glitch can't pick the plan.
+    init_gps();
+    lora_region_t region = REGION_UNKNOWN;
+    for (int i = 0; i < BOOT_REGION_WINDOWS; i++) {
+        telemetry_t t = {};
+        gps_loop();
+        if (is_fix_valid() && read_gps(t) && t.quality == FIX_GOOD) {
+            region = region_lookup_packed(t.lat, t.lon);
+            break;
+        }
+    }
+    // check_region() switches later on if this is wrong
+    if (region == REGION_UNKNOWN) {
+        region = DEFAULT_REGION;
+    }
+
+    if (region == REGION_NO_GO) {
+        current_region = REGION_NO_GO;
+        printf("\r\n In a no-go region, not joining \r\n");
+        lora_ev_queue.profiled_call(EVQ_SLOT_SKIP_CYCLE, skip_cycle);
+    } else if (!start_lorawan(region)) {
+        // Nothing else would ever retry, start over like a failed join
+        printf("\r\n LoRaWAN start failed, resetting \r\n");
+        standby(SLOW_TX_TIMER);
+        system_reset();
+    }
 
     // make event queue dispatching events forever
     lora_ev_queue.dispatch_forever();
@@ -219,123 +387,221 @@ int main(void)
 }
 
 /**
- * Enter deep sleep
+ * Enter deep sleep, then wait for a GPS fix. Neither is work, so the event
+ * queue profile leaves them out of the calling callback's execution time.
  */
 void standby(Kernel::Clock::duration_u32 sec) {
-    sleep_manager_unlock_deep_sleep();
-    mbed_file_handle(STDIN_FILENO)->enable_input(false);
-    mbed_file_handle(STDOUT_FILENO)->enable_output(false);
-    p_vcc.write(0);
-    ThisThread::sleep_for(sec);
-    p_vcc.write(1);
-    mbed_file_handle(STDIN_FILENO)->enable_input(true);
-    mbed_file_handle(STDOUT_FILENO)->enable_output(true);
-    sleep_manager_lock_deep_sleep();
-    ThisThread::sleep_for(2s);
-    gps_loop();
+    lora_ev_queue.idle([sec]() {
+        sleep_manager_unlock_deep_sleep();
+        mbed_file_handle(STDIN_FILENO)->enable_input(false);
+        mbed_file_handle(STDOUT_FILENO)->enable_output(false);
+        p_vcc.write(0);
+        ThisThread::sleep_for(sec);
+        p_vcc.write(1);
+        mbed_file_handle(STDIN_FILENO)->enable_input(true);
+        mbed_file_handle(STDOUT_FILENO)->enable_output(true);
+        sleep_manager_lock_deep_sleep();
+        ThisThread::sleep_for(2s);
+        gps_loop();
+    });
 }
 
 /**
- * Transmit a payload when we don't have a gps fix
+ * Run the last GPS fix through the filter and read it into the telemetry.
+ * Returns false if there's no position worth spending airtime on.
  */
-static void send_no_gps() {    
-    uint8_t packet_len = 6;
-    int16_t retcode;
-
-    float raw_adc;
-    float calc_voltage;
-    uint16_t battery;
-    uint8_t battery_packed;
+static bool read_gps(telemetry_t &t) {
+    gps_fix_t fix;
+    gps_fix_t estimate;
+    fix_quality_t quality;
+    uint16_t speed;
+
+    fix.lat = lround(gps_parser.location.lat() * 1e6);
+    fix.lon = lround(gps_parser.location.lng() * 1e6);
+    fix.altitude = lround(gps_parser.altitude.meters());
+    fix.hdop = 0;
+    if (gps_parser.hdop.isValid())
+        fix.hdop = gps_parser.hdop.value() > 0xFFFF ? 0xFFFF : gps_parser.hdop.value();
+    fix.sats = gps_parser.satellites.value();
+    fix.age = gps_parser.location.age();
+
+    quality = fix_filter.update(fix, time(NULL), estimate);
+
+    printf("\r\n Fix quality %d (%lu good, %lu degraded, %lu estimated, %lu rejected) \r\n", quality,
+           (unsigned long)fix_filter.count(FIX_GOOD), (unsigned long)fix_filter.count(FIX_DEGRADED),
+           (unsigned long)fix_filter.count(FIX_ESTIMATED), (unsigned long)fix_filter.count(FIX_REJECTED));
+
+    if (quality == FIX_REJECTED)
+        return false;
+
+    t.has_fix = true;
+    t.quality = quality;
+    t.lat = payload_pack_lat(estimate.lat / 1e6);
+    t.lon = payload_pack_lon(estimate.lon / 1e6);
+    // The filter has already thrown out nonsense, this just keeps it in range
+    t.altitude = estimate.altitude < 0 ? 0 : estimate.altitude > 0xFFFF ? 0xFFFF : estimate.altitude;
 
-    raw_adc = voltage.read();
-    calc_voltage = (3.3f*raw_adc*(2.0f));
-    battery_packed = (calc_voltage - 2)*(255/2.3f);
-    tx_buffer[0] = battery_packed & 0xFF;
-
-    packBMP280Stuff(false);
-
-    retcode = lorawan.send(STATUS_PORT, tx_buffer, packet_len,
-                           MSG_UNCONFIRMED_FLAG);
+    speed = (uint16_t)gps_parser.speed.kmph();  // convert from double
+    if (speed > 255)
+        speed = 255;  // don't wrap around.
+    t.speed = speed;
 
-    if (retcode < 0) {
-        retcode == LORAWAN_STATUS_WOULD_BLOCK ? printf("send - WOULD BLOCK\r\n")
-        : printf("\r\n send() - Error code %d \r\n", retcode);
+    t.sats = estimate.sats;
+    return true;
+}
 
-        return;
+/**
+ * Feed this cycle's readings to the flight phase detector and apply the
+ * new phase's GPS window
+ */
+static void update_flight_phase(const telemetry_t &t) {
+    flight_sample_t sample;
+    flight_phase_t previous = flight_phase.phase();
+
+    sample.time = time(NULL);
+    sample.pressure = t.pressure;
+    // Estimated fixes come from the filter's own vertical speed, don't count them twice
+    sample.has_altitude = t.has_fix && t.quality != FIX_ESTIMATED;
+    sample.altitude = t.altitude;
+    sample.has_vertical_speed = sample.has_altitude && fix_filter.has_vertical_speed();
+    sample.vertical_speed = fix_filter.vertical_speed();
+
+    flight_phase.update(sample);
+    if (flight_phase.phase() != previous) {
+        printf("\r\n Flight phase %s -> %s \r\n", flight_phase_name(previous),
+               flight_phase_name(flight_phase.phase()));
     }
+    set_gps_wait(phase_policies[flight_phase.phase()].gps_window);
+}
 
-    printf("\r\n %d bytes scheduled for transmission \r\n", retcode);
-    memset(tx_buffer, 0, sizeof(tx_buffer));
+/**
+ * Time until the next uplink in the current flight phase
+ */
+static Kernel::Clock::duration_u32 tx_interval(void) {
+    return std::chrono::seconds(flight_tx_interval(flight_phase));
 }
 
 /**
- * Transmit a payload with GPS
+ * Transmit whatever changed since the last uplink
  */
-static void send_gps() {
-    uint16_t packet_len = 16;
+static void send_telemetry(const telemetry_t &t) {
+    uint8_t port;
+    uint8_t packet_len;
     int16_t retcode;
 
-    double lat;
-    double lon;
-    uint16_t altitude;
-    uint8_t sats;
-    uint8_t speed;
-
-    float raw_adc;
-    float calc_voltage;
-    uint16_t battery;
-    uint8_t battery_packed;
-
-    // Packet all the GPS information
-    lat = gps_parser.location.lat();
-    lon = gps_parser.location.lng();
-    pack_lat_lon(lat, lon);
-
-    altitude = (uint16_t)gps_parser.altitude.meters();
-    if (altitude <= 0)
-        altitude = 1; // avoid negatives, they are most likely a result of a poor fix or bug in the code and it's easier to use unsigned integers.
-
-    speed = (uint16_t)gps_parser.speed.kmph();  // convert from double
-    if (speed > 255)
-        speed = 255;  // don't wrap around.
-    
-    sats = gps_parser.satellites.value();
-
-    tx_buffer[6] = (altitude >> 8) & 0xFF;
-    tx_buffer[7] = altitude & 0xFF;
-    tx_buffer[8] = speed & 0xFF;
-    tx_buffer[9] = sats & 0xFF;
-
-    raw_adc = voltage.read();
-    calc_voltage = (3.3f*raw_adc*(2.0f));
-    battery_packed = (calc_voltage - 2)*(255/2.3f);
-    tx_buffer[10] = battery_packed & 0xFF;
+    packet_len = payload_encoder.encode(t, tx_buffer, sizeof(tx_buffer), port);
 
-    packBMP280Stuff(true);
-
-    retcode = lorawan.send(GPS_PORT, tx_buffer, packet_len,
+    retcode = lorawan->send(port, tx_buffer, packet_len,
                            MSG_UNCONFIRMED_FLAG);
 
     if (retcode < 0) {
         retcode == LORAWAN_STATUS_WOULD_BLOCK ? printf("send - WOULD BLOCK\r\n")
         : printf("\r\n send() - Error code %d \r\n", retcode);
 
+        payload_encoder.discard();
         return;
     }
 
-    printf("\r\n %d bytes scheduled for transmission \r\n", retcode);
+    // A short send means the datarate can't carry the whole payload, the
+    // ground would drop the truncated frame so don't move the encoder on
+    if (retcode < packet_len) {
+        printf("\r\n send() - Only %d of %u bytes fit \r\n", retcode, packet_len);
+        payload_encoder.discard();
+        return;
+    }
+
+    // Committed on TX_DONE, the frame can still fail to go out
+    printf("\r\n %d bytes scheduled for transmission on port %u \r\n", retcode, port);
     memset(tx_buffer, 0, sizeof(tx_buffer));
 }
 
+/**
+ * Finish a frequency plan switch once the old stack has shut down
+ */
+static void switch_region() {
+    lora_region_t region = pending_region;
+    pending_region = REGION_UNKNOWN;
+
+    if (region == REGION_NO_GO) {
+        stop_lorawan();
+        current_region = REGION_NO_GO;
+        skip_cycle();
+    } else if (!start_lorawan(region)) {
+        // Try again from the next fix
+        stop_lorawan();
+        current_region = REGION_NO_GO;
+        skip_cycle();
+    }
+}
+
+/**
+ * Check a fix against the geofences and start switching frequency plan once
+ * we've seen REGION_SWITCH_FIXES fixes in a new region.
+ * Returns false if we mustn't transmit this cycle.
+ */
+static bool check_region(const telemetry_t &t) {
+    lora_region_t region = region_lookup_packed(t.lat, t.lon);
+
+    if (region == REGION_UNKNOWN || region == current_region) {
+        candidate_fixes = 0;
+        if (current_region == REGION_NO_GO) {
+            lora_ev_queue.profiled_call(EVQ_SLOT_SKIP_CYCLE, skip_cycle);
+            return false;
+        }
+        return true;
+    }
+
+    if (region != candidate_region) {
+        candidate_region = region;
+        candidate_fixes = 0;
+    }
+    if (++candidate_fixes < REGION_SWITCH_FIXES) {
+        // Don't transmit on the old plan while we make sure
+        lora_ev_queue.profiled_call(EVQ_SLOT_SKIP_CYCLE, skip_cycle);
+        return false;
+    }
+
+    candidate_fixes = 0;
+    pending_region = region;
+    printf("\r\n Entered %s region \r\n", region_name(region));
+    if (lorawan) {
+        // DISCONNECTED finishes the switch
+        lorawan->shutdown();
+    } else {
+        lora_ev_queue.profiled_call(EVQ_SLOT_SWITCH_REGION, switch_region);
+    }
+    return false;
+}
+
 /**
  * Sends a message to the Network Server
  */
 static void send_message() {
-    if (is_fix_valid()) {
-        send_gps();
-    } else {
-        send_no_gps();
+    telemetry_t t = {};
+
+    if (is_fix_valid() && read_gps(t)) {
+        if (!check_region(t)) {
+            return;
+        }
+    } else if (current_region == REGION_NO_GO) {
+        lora_ev_queue.profiled_call(EVQ_SLOT_SKIP_CYCLE, skip_cycle);
+        return;
+    }
+    read_battery(t);
+    read_bmp280(t);
+    read_mem_stats(t);
+
+    update_flight_phase(t);
+    if (phase_policies[flight_phase.phase()].keyframes) {
+        payload_encoder.force_keyframe();
     }
+
+    send_telemetry(t);
+}
+
+static void skip_cycle(void) {
+    standby(tx_interval());
+    send_message();
 }
 
 /**
@@ -345,7 +611,7 @@ static void receive_message()
 {
     uint8_t port;
     int flags;
-    int16_t retcode = lorawan.receive(rx_buffer, sizeof(rx_buffer), port, flags);
+    int16_t retcode = lorawan->receive(rx_buffer, sizeof(rx_buffer), port, flags);
 
     if (retcode < 0) {
         printf("\r\n receive() - Error code %d \r\n", retcode);
@@ -358,6 +624,10 @@ static void receive_message()
     }
     printf("\r\n");
 
+    if (port == EVQ_DUMP_PORT) {
+        lora_ev_queue.dump();
+    }
+
     memset(rx_buffer, 0, sizeof(rx_buffer));
 }
 
@@ -370,28 +640,33 @@ static void lora_event_handler(lorawan_event_t event)
         case CONNECTED:
             printf("\r\n Connection - Successful \r\n");
 
-            // Set data rate
-            if (lorawan.set_datarate(0) != LORAWAN_STATUS_OK) {
+            // Set data rate, the slowest one a keyframe fits in
+            if (lorawan->set_datarate(region_datarate(current_region).datarate) != LORAWAN_STATUS_OK) {
                 printf("\r\n set_datarate failed! \r\n");
+            } else {
+                printf("\r\n Data rate set successfully \r\n");
             }
-            printf("\r\n Data rate set successfully \r\n");
             
             // Start GPS Loop
-            init_gps();
-            gps_loop();
+            lora_ev_queue.idle(gps_loop);
             send_message();
             break;
         case DISCONNECTED:
-            lora_ev_queue.break_dispatch();
             printf("\r\n Disconnected Successfully \r\n");
+            if (pending_region != REGION_UNKNOWN) {
+                lora_ev_queue.profiled_call(EVQ_SLOT_SWITCH_REGION, switch_region);
+            } else {
+                lora_ev_queue.break_dispatch();
+            }
             break;
         case TX_DONE:
             printf("\r\n Message Sent to Network Server \r\n");
+            payload_encoder.commit();
             if (get_need_longer_sleep()) {
                 standby(SLOW_TX_TIMER);
                 set_need_longer_sleep(false);
             } else {
-                standby(TX_TIMER);
+                standby(tx_interval());
             }
             send_message();
             break;
@@ -400,6 +675,10 @@ static void lora_event_handler(lorawan_event_t event)
         case TX_CRYPTO_ERROR:
         case TX_SCHEDULING_ERROR:
             printf("\r\n Transmission Error - EventCode = %d \r\n", event);
+            // The ground never saw it, keep deltas against the last frame sent.
+            // Nothing else will schedule the next uplink.
+            payload_encoder.discard();
+            lora_ev_queue.profiled_call(EVQ_SLOT_SKIP_CYCLE, skip_cycle);
             break;
         case RX_DONE:
             printf("\r\n Received message from Network Server \r\n");
@@ -30,10 +30,36 @@
 #define MBEDTLS_AES_C
 #define MBEDTLS_CMAC_C
 
+/*
+ * AES backend, selected per target with app.aes-backend in mbed_app.json.
+ * See aes_backend.cpp for the hardware implementation.
+ */
+#define APP_AES_BACKEND_SW_SMALL    0   // software, reduced tables generated in RAM
+#define APP_AES_BACKEND_SW_FAST     1   // software, full tables in flash
+#define APP_AES_BACKEND_HW          2   // STM32WL AES peripheral
+
+#ifndef MBED_CONF_APP_AES_BACKEND
+#define MBED_CONF_APP_AES_BACKEND   APP_AES_BACKEND_SW_SMALL
+#endif
+
+#if MBED_CONF_APP_AES_BACKEND == APP_AES_BACKEND_SW_SMALL
 // Reduce ROM usage by optimizing some mbedtls features.
 // These are only reference configurations for this LoRa example application.
 // Other LoRa applications might need different configurations.
 #define MBEDTLS_AES_FEWER_TABLES
+#elif MBED_CONF_APP_AES_BACKEND == APP_AES_BACKEND_SW_FAST
+// All four round tables, precomputed in flash so they cost no RAM
+#define MBEDTLS_AES_ROM_TABLES
+#elif MBED_CONF_APP_AES_BACKEND == APP_AES_BACKEND_HW
+#if !defined(TARGET_STM32WL)
+#error "aes-backend 2 needs the STM32WL AES peripheral"
+#endif
+// LoRaWAN only ever encrypts, decryption and the key schedule stay in software
+#define MBEDTLS_AES_ENCRYPT_ALT
+#define MBEDTLS_AES_FEWER_TABLES
+#else
+#error "Unknown aes-backend"
+#endif
 
 #undef MBEDTLS_GCM_C
 #undef MBEDTLS_CHACHA20_C
@@ -0,0 +1,343 @@
+#include "payload.h"
+
+#include <string.h>
+
+#define LAT_LON_SCALE   16777215.0
+
+uint32_t payload_pack_lat(double lat) {
+    return ((lat + 90) / 180.0) * LAT_LON_SCALE;
+}
+
+uint32_t payload_pack_lon(double lon) {
+    return ((lon + 180) / 360.0) * LAT_LON_SCALE;
+}
+
+double payload_unpack_lat(uint32_t lat) {
+    return (lat / LAT_LON_SCALE) * 180.0 - 90;
+}
+
+double payload_unpack_lon(uint32_t lon) {
+    return (lon / LAT_LON_SCALE) * 360.0 - 180;
+}
+
+/**
+ * Round to the nearest multiple of step without exceeding max
+ */
+static uint32_t quantise_value(uint32_t value, uint32_t step, uint32_t max) {
+    if (step <= 1)
+        return value;
+    uint32_t q = ((value + step / 2) / step) * step;
+    if (q > max)
+        q -= step;
+    return q;
+}
+
+/**
+ * Coarse positions only keep the top 16 bits, the ground puts them back
+ * in the middle of the dropped range.
+ */
+static uint32_t coarse_position(uint32_t value) {
+    return ((value >> 8) << 8) | 0x80;
+}
+
+/**
+ * Satellites and fix quality share a byte
+ */
+static uint8_t pack_sats(const telemetry_t &t) {
+    return ((t.quality & 0x03) << 6) | (t.sats > 0x3F ? 0x3F : t.sats);
+}
+
+static void unpack_sats(uint8_t value, telemetry_t &t) {
+    t.quality = value >> 6;
+    t.sats = value & 0x3F;
+}
+
+static uint8_t put_u24(uint8_t *buf, uint32_t value) {
+    buf[0] = (value >> 16) & 0xFF;
+    buf[1] = (value >> 8) & 0xFF;
+    buf[2] = value & 0xFF;
+    return 3;
+}
+
+static uint8_t put_u16(uint8_t *buf, uint16_t value) {
+    buf[0] = (value >> 8) & 0xFF;
+    buf[1] = value & 0xFF;
+    return 2;
+}
+
+static uint32_t get_u24(const uint8_t *buf) {
+    return ((uint32_t)buf[0] << 16) | ((uint32_t)buf[1] << 8) | buf[2];
+}
+
+static uint16_t get_u16(const uint8_t *buf) {
+    return ((uint16_t)buf[0] << 8) | buf[1];
+}
+
+PayloadEncoder::PayloadEncoder(uint8_t keyframe_interval, const payload_precision_t &precision)
+    : _precision(precision),
+      _keyframe_interval(keyframe_interval),
+      _since_keyframe(0),
+      _have_last(false),
+      _staged(false),
+      _pending_keyframe(false),
+      _force_keyframe(false)
+{
+    memset(&_last, 0, sizeof(_last));
+    memset(&_pending, 0, sizeof(_pending));
+}
+
+telemetry_t PayloadEncoder::quantise(const telemetry_t &t) const {
+    telemetry_t q = t;
+    q.altitude = quantise_value(t.altitude, _precision.altitude_step, 0xFFFF);
+    q.pressure = quantise_value(t.pressure, _precision.pressure_step, 0xFFFFFF);
+    q.temp = quantise_value(t.temp, _precision.temp_step, 0xFFFF);
+    q.battery = quantise_value(t.battery, _precision.battery_step, 0xFF);
+    return q;
+}
+
+uint8_t PayloadEncoder::encode(const telemetry_t &t, uint8_t *buf, uint8_t size, uint8_t &port) {
+    uint8_t len = 0;
+
+    if (size < PAYLOAD_MAX_LEN)
+        return 0;
+
+    _pending = quantise(t);
+    _staged = true;
+
+    _pending_keyframe = _force_keyframe || !_have_last
+                        || (_last.has_fix != _pending.has_fix)
+                        || (_since_keyframe + 1 >= _keyframe_interval);
+
+    if (_pending_keyframe) {
+        if (_pending.has_fix) {
+            port = GPS_PORT;
+            len += put_u24(&buf[len], _pending.lat);
+            len += put_u24(&buf[len], _pending.lon);
+            len += put_u16(&buf[len], _pending.altitude);
+            buf[len++] = _pending.speed;
+            buf[len++] = pack_sats(_pending);
+        } else {
+            port = STATUS_PORT;
+        }
+        buf[len++] = _pending.battery;
+        len += put_u24(&buf[len], _pending.pressure);
+        len += put_u16(&buf[len], _pending.temp);
+        if (_pending.has_mem_stats) {
+            len += put_u16(&buf[len], _pending.stack_max);
+            len += put_u16(&buf[len], _pending.heap_max);
+            if (_pending.has_evq_stats) {
+                buf[len++] = _pending.evq_peak;
+                buf[len++] = _pending.evq_failures;
+            }
+        }
+        return len;
+    }
+
+    uint8_t bitmap = 0;
+    port = DELTA_PORT;
+    len = 1;
+
+    if (_pending.has_fix) {
+        bool coarse = _precision.coarse_position_above
+                      && _pending.altitude >= _precision.coarse_position_above;
+        if (coarse) {
+            _pending.lat = coarse_position(_pending.lat);
+            _pending.lon = coarse_position(_pending.lon);
+        }
+        if (_pending.lat != _last.lat || _pending.lon != _last.lon) {
+            bitmap |= DELTA_POS;
+            if (coarse) {
+                bitmap |= DELTA_POS_COARSE;
+                len += put_u16(&buf[len], _pending.lat >> 8);
+                len += put_u16(&buf[len], _pending.lon >> 8);
+            } else {
+                len += put_u24(&buf[len], _pending.lat);
+                len += put_u24(&buf[len], _pending.lon);
+            }
+        }
+        if (_pending.altitude != _last.altitude) {
+            bitmap |= DELTA_ALTITUDE;
+            len += put_u16(&buf[len], _pending.altitude);
+        }
+        if (_pending.speed != _last.speed) {
+            bitmap |= DELTA_SPEED;
+            buf[len++] = _pending.speed;
+        }
+        if (pack_sats(_pending) != pack_sats(_last)) {
+            bitmap |= DELTA_SATS;
+            buf[len++] = pack_sats(_pending);
+        }
+    }
+    if (_pending.battery != _last.battery) {
+        bitmap |= DELTA_BATTERY;
+        buf[len++] = _pending.battery;
+    }
+    if (_pending.pressure != _last.pressure) {
+        bitmap |= DELTA_PRESSURE;
+        len += put_u24(&buf[len], _pending.pressure);
+    }
+    if (_pending.temp != _last.temp) {
+        bitmap |= DELTA_TEMP;
+        len += put_u16(&buf[len], _pending.temp);
+    }
+
+    // Fields we didn't send are still whatever the ground last saw
+    if (!(bitmap & DELTA_POS)) {
+        _pending.lat = _last.lat;
+        _pending.lon = _last.lon;
+    }
+
+    buf[0] = bitmap;
+    return len;
+}
+
+void PayloadEncoder::commit(void) {
+    if (!_staged)
+        return;
+    _staged = false;
+    _last = _pending;
+    _have_last = true;
+    if (_pending_keyframe) {
+        _since_keyframe = 0;
+        _force_keyframe = false;
+    } else {
+        _since_keyframe++;
+    }
+}
+
+void PayloadEncoder::discard(void) {
+    _staged = false;
+}
+
+void PayloadEncoder::force_keyframe(void) {
+    _force_keyframe = true;
+}
+
+PayloadDecoder::PayloadDecoder(void)
+    : _have_keyframe(false),
+      _stale(false),
+      _have_fcnt(false),
+      _last_fcnt(0)
+{
+    memset(&_state, 0, sizeof(_state));
+}
+
+bool PayloadDecoder::decode(uint8_t port, const uint8_t *buf, uint8_t len, uint32_t fcnt, telemetry_t &out) {
+    bool gap = _have_fcnt && (fcnt != _last_fcnt + 1);
+    uint8_t offset = 0;
+
+    switch (port) {
+        case GPS_PORT:
+            if (len < GPS_PAYLOAD_LEN)
+                return false;
+            _state.has_fix = true;
+            _state.lat = get_u24(&buf[0]);
+            _state.lon = get_u24(&buf[3]);
+            _state.altitude = get_u16(&buf[6]);
+            _state.speed = buf[8];
+            unpack_sats(buf[9], _state);
+            offset = 10;
+            break;
+        case STATUS_PORT:
+            if (len < STATUS_PAYLOAD_LEN)
+                return false;
+            _state.has_fix = false;
+            break;
+        case DELTA_PORT:
+            return decode_delta(buf, len, fcnt, gap, out);
+        default:
+            return false;
+    }
+
+    _state.battery = buf[offset];
+    _state.pressure = get_u24(&buf[offset + 1]);
+    _state.temp = get_u16(&buf[offset + 4]);
+    offset += 6;
+
+    _state.has_mem_stats = len >= offset + MEM_STATS_LEN;
+    if (_state.has_mem_stats) {
+        _state.stack_max = get_u16(&buf[offset]);
+        _state.heap_max = get_u16(&buf[offset + 2]);
+        offset += MEM_STATS_LEN;
+    }
+
+    _state.has_evq_stats = _state.has_mem_stats && len >= offset + EVQ_STATS_LEN;
+    if (_state.has_evq_stats) {
+        _state.evq_peak = buf[offset];
+        _state.evq_failures = buf[offset + 1];
+    }
+
+    _have_keyframe = true;
+    _stale = false;
+    _have_fcnt = true;
+    _last_fcnt = fcnt;
+    out = _state;
+    return true;
+}
+
+bool PayloadDecoder::decode_delta(const uint8_t *buf, uint8_t len, uint32_t fcnt, bool gap, telemetry_t &out) {
+    if (!_have_keyframe || len < 1)
+        return false;
+
+    uint8_t bitmap = buf[0];
+    uint8_t need = 1;
+    if (bitmap & DELTA_POS)
+        need += (bitmap & DELTA_POS_COARSE) ? 4 : 6;
+    if (bitmap & DELTA_ALTITUDE)
+        need += 2;
+    if (bitmap & DELTA_SPEED)
+        need += 1;
+    if (bitmap & DELTA_SATS)
+        need += 1;
+    if (bitmap & DELTA_BATTERY)
+        need += 1;
+    if (bitmap & DELTA_PRESSURE)
+        need += 3;
+    if (bitmap & DELTA_TEMP)
+        need += 2;
+    if (len < need)
+        return false;
+
+    telemetry_t next = _state;
+    uint8_t offset = 1;
+    if (bitmap & DELTA_POS) {
+        if (bitmap & DELTA_POS_COARSE) {
+            next.lat = coarse_position((uint32_t)get_u16(&buf[offset]) << 8);
+            next.lon = coarse_position((uint32_t)get_u16(&buf[offset + 2]) << 8);
+            offset += 4;
+        } else {
+            next.lat = get_u24(&buf[offset]);
+            next.lon = get_u24(&buf[offset + 3]);
+            offset += 6;
+        }
+    }
+    if (bitmap & DELTA_ALTITUDE) {
+        next.altitude = get_u16(&buf[offset]);
+        offset += 2;
+    }
+    if (bitmap & DELTA_SPEED)
+        next.speed = buf[offset++];
+    if (bitmap & DELTA_SATS)
+        unpack_sats(buf[offset++], next);
+    if (bitmap & DELTA_BATTERY)
+        next.battery = buf[offset++];
+    if (bitmap & DELTA_PRESSURE) {
+        next.pressure = get_u24(&buf[offset]);
+        offset += 3;
+    }
+    if (bitmap & DELTA_TEMP) {
+        next.temp = get_u16(&buf[offset]);
+        offset += 2;
+    }
+
+    if (gap)
+        _stale = true;
+    _state = next;
+    _last_fcnt = fcnt;
+    out = _state;
+    return true;
+}
+
+bool PayloadDecoder::is_stale(void) const {
+    return _stale;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Ports for different types of message
+ *
+ * GPS_PORT and STATUS_PORT carry full keyframes in the original fixed
+ * layouts, with one format change: the top two bits of the GPS_PORT sats
+ * byte (byte 9) carry the fix quality, so decoders written before it must
+ * mask that byte with 0x3F. DELTA_PORT carries a presence bitmap followed
+ * by only the fields that changed since the last uplink.
+ */
+#define GPS_PORT    2
+#define STATUS_PORT 3
+#define DELTA_PORT  4
+
+#define GPS_PAYLOAD_LEN     16
+#define STATUS_PAYLOAD_LEN  6
+#define MEM_STATS_LEN       4   // optional keyframe trailer
+#define EVQ_STATS_LEN       2   // optional, follows the memory stats
+#define PAYLOAD_MAX_LEN     (GPS_PAYLOAD_LEN + MEM_STATS_LEN + EVQ_STATS_LEN)
+
+/**
+ * Delta payload presence bitmap, fields follow in bit order
+ */
+#define DELTA_POS           (1 << 0)    // lat/lon, 3 bytes each
+#define DELTA_POS_COARSE    (1 << 1)    // with DELTA_POS, lat/lon are 2 bytes each
+#define DELTA_ALTITUDE      (1 << 2)    // 2 bytes
+#define DELTA_SPEED         (1 << 3)    // 1 byte
+#define DELTA_SATS          (1 << 4)    // 1 byte, with the fix quality
+#define DELTA_BATTERY       (1 << 5)    // 1 byte
+#define DELTA_PRESSURE      (1 << 6)    // 3 bytes
+#define DELTA_TEMP          (1 << 7)    // 2 bytes
+
+/**
+ * One set of readings, already in on-air units
+ */
+struct telemetry_t {
+    bool has_fix;
+    uint32_t lat;       // 24 bit, (lat + 90) / 180 * 0xFFFFFF
+    uint32_t lon;       // 24 bit, (lon + 180) / 360 * 0xFFFFFF
+    uint16_t altitude;  // m
+    uint8_t speed;      // km/h
+    uint8_t sats;       // sent in bits 0-5
+    uint8_t quality;    // fix_quality_t, sent in bits 6-7 of sats
+    uint8_t battery;    // (V - 2) * 255 / 2.3
+    uint32_t pressure;  // Pa
+    uint16_t temp;      // 0.1 C + 128
+    bool has_mem_stats; // only sent in keyframes
+    uint16_t stack_max; // bytes, main thread high-water mark
+    uint16_t heap_max;  // bytes, heap high-water mark
+    bool has_evq_stats; // only sent with the memory stats
+    uint8_t evq_peak;   // %, event queue peak occupancy
+    uint8_t evq_failures; // failed event posts, saturates at 255
+};
+
+/**
+ * Quantisation applied to each field before change detection.
+ * A step of 0 or 1 keeps full precision.
+ */
+struct payload_precision_t {
+    uint16_t altitude_step;         // m
+    uint16_t pressure_step;         // Pa
+    uint8_t temp_step;              // 0.1 C
+    uint8_t battery_step;           // packed battery units
+    uint16_t coarse_position_above; // m, send 16 bit lat/lon above this altitude, 0 disables
+};
+
+uint32_t payload_pack_lat(double lat);
+uint32_t payload_pack_lon(double lon);
+double payload_unpack_lat(uint32_t lat);
+double payload_unpack_lon(uint32_t lon);
+
+/**
+ * Keeps the last-sent state and emits either a keyframe or a delta.
+ *
+ * encode() only stages the payload. Call commit() once it has actually
+ * gone out (TX done) and discard() when the stack gives up on it, so a
+ * frame the ground never sees doesn't become the next delta's reference.
+ */
+class PayloadEncoder {
+public:
+    PayloadEncoder(uint8_t keyframe_interval, const payload_precision_t &precision);
+
+    uint8_t encode(const telemetry_t &t, uint8_t *buf, uint8_t size, uint8_t &port);
+    void commit(void);
+    void discard(void);
+    void force_keyframe(void);
+
+private:
+    telemetry_t quantise(const telemetry_t &t) const;
+
+    payload_precision_t _precision;
+    uint8_t _keyframe_interval;
+    uint8_t _since_keyframe;
+    bool _have_last;
+    bool _staged;
+    bool _pending_keyframe;
+    bool _force_keyframe;
+    telemetry_t _last;
+    telemetry_t _pending;
+};
+
+/**
+ * Rebuilds the full state from keyframes and deltas.
+ *
+ * Frames must be passed in frame counter order. After a gap in the frame
+ * counter fields not present in later deltas may be stale until the next
+ * keyframe, which is_stale() reports.
+ */
+class PayloadDecoder {
+public:
+    PayloadDecoder(void);
+
+    bool decode(uint8_t port, const uint8_t *buf, uint8_t len, uint32_t fcnt, telemetry_t &out);
+    bool is_stale(void) const;
+
+private:
+    bool decode_delta(const uint8_t *buf, uint8_t len, uint32_t fcnt, bool gap, telemetry_t &out);
+
+    bool _have_keyframe;
+    bool _stale;
+    bool _have_fcnt;
+    uint32_t _last_fcnt;
+    telemetry_t _state;
+};
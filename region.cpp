@@ -0,0 +1,277 @@
+#include "region.h"
+#include "payload.h"
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+/**
+ * Coarse geofences, lon/lat in hundredths of a degree.
+ *
+ * Checked in order and the first match wins, so small regions come before
+ * the large catch-all ones they overlap. Polygons don't cross the
+ * antimeridian, split them instead.
+ */
+static const geo_point_t russia[] = {
+    // Norway and Finland
+    {4000, 8200}, {3100, 7050}, {3085, 6979}, {3010, 6965}, {2930, 6935},
+    {2890, 6905}, {2840, 6850}, {2990, 6770}, {2910, 6685}, {3010, 6580},
+    {3000, 6450}, {3060, 6410}, {2990, 6370}, {3160, 6290}, {3070, 6220},
+    {2965, 6155}, {2882, 6115}, {2800, 6060}, {2780, 6055},
+    // Estonia, Latvia and Belarus
+    {2800, 5975}, {2820, 5950}, {2820, 5920}, {2775, 5890}, {2770, 5800},
+    {2770, 5755}, {2785, 5730}, {2820, 5680}, {2815, 5615}, {2990, 5585},
+    {3090, 5560}, {3095, 5500}, {3100, 5470}, {3185, 5405}, {3275, 5340},
+    {3160, 5260}, {3178, 5210},
+    // Ukraine
+    {3380, 5235}, {3440, 5175}, {3420, 5130}, {3540, 5065}, {3620, 5045},
+    {3750, 5035}, {3820, 5000}, {3980, 4960}, {4010, 4900}, {3980, 4830},
+    {3825, 4715},
+    // Black Sea coast, Georgia and Azerbaijan
+    {3662, 4545}, {3660, 4510}, {3800, 4430}, {3995, 4335}, {4000, 4340},
+    {4160, 4325}, {4280, 4320}, {4400, 4275}, {4500, 4260}, {4580, 4210},
+    {4660, 4185}, {4850, 4185},
+    // Caspian Sea and Kazakhstan
+    {5000, 4300}, {4950, 4500}, {4895, 4630}, {4710, 4780}, {4650, 4850},
+    {4670, 4940}, {4750, 5040}, {4870, 5060}, {5050, 5165}, {5250, 5150},
+    {5500, 5085}, {5750, 5090}, {5950, 5060}, {6140, 5080}, {6100, 5200},
+    {6120, 5300}, {6200, 5395}, {6500, 5465}, {6900, 5535}, {7080, 5520},
+    {7120, 5420}, {7350, 5395}, {7650, 5420}, {7800, 5320}, {8000, 5125},
+    {8150, 5080}, {8350, 5095}, {8550, 4960}, {8730, 4910},
+    // Mongolia
+    {9000, 5040}, {9200, 5075}, {9450, 5000}, {9750, 4990}, {9830, 5060},
+    {9890, 5210}, {10200, 5140}, {10450, 5030}, {10650, 5035}, {10800, 4950},
+    {11050, 4920}, {11400, 5020}, {11670, 4985},
+    // China
+    {11780, 4950}, {11920, 5030}, {12000, 5170}, {12100, 5330}, {12350, 5355},
+    {12600, 5290}, {12750, 5000}, {13050, 4890}, {13100, 4770}, {13300, 4810},
+    {13470, 4835}, {13400, 4730}, {13350, 4620}, {13310, 4510}, {13250, 4500},
+    {13185, 4530}, {13110, 4490}, {13130, 4410}, {13110, 4340}, {13060, 4242},
+    // Sea of Japan, Kurils, Kamchatka and the Bering Sea
+    {13070, 4220}, {13250, 4230}, {13600, 4360}, {14120, 4575}, {14190, 4572},
+    {14550, 4460}, {14750, 4460}, {15000, 4550}, {15600, 5000}, {16050, 5250},
+    {16300, 5500}, {16450, 5950}, {17200, 6100}, {18000, 6200}, {18000, 8200}
+};
+
+/**
+ * Chukotka east of the antimeridian
+ */
+static const geo_point_t russia_east[] = {
+    {-18000, 6420}, {-16900, 6420}, {-16900, 7200}, {-18000, 7200}
+};
+
+static const geo_point_t kaliningrad[] = {
+    {1960, 5445}, {2275, 5440}, {2275, 5485}, {2200, 5508}, {2125, 5525},
+    {2095, 5529}, {1960, 5500}
+};
+
+static const geo_point_t china[] = {
+    // Mongolia
+    {8730, 4910}, {8800, 4860}, {9000, 4790}, {9100, 4660}, {9090, 4530},
+    {9350, 4490}, {9530, 4430}, {9640, 4270}, {10000, 4260}, {10500, 4160},
+    {10750, 4240}, {11050, 4260}, {11190, 4360}, {11350, 4480}, {11660, 4630},
+    {11970, 4660}, {11850, 4790}, {11740, 4770}, {11560, 4790}, {11670, 4985},
+    // Russia, the same vertices as above
+    {11780, 4950}, {11920, 5030}, {12000, 5170}, {12100, 5330}, {12350, 5355},
+    {12600, 5290}, {12750, 5000}, {13050, 4890}, {13100, 4770}, {13300, 4810},
+    {13470, 4835}, {13400, 4730}, {13350, 4620}, {13310, 4510}, {13250, 4500},
+    {13185, 4530}, {13110, 4490}, {13130, 4410}, {13110, 4340}, {13060, 4242},
+    // North Korea and the coast
+    {13025, 4270}, {12920, 4235}, {12810, 4195}, {12680, 4170}, {12530, 4060},
+    {12430, 3990}, {12120, 3850}, {12280, 3730}, {12000, 3450}, {12200, 3170},
+    {12250, 3000}, {12150, 2800}, {11970, 2550}, {11870, 2440}, {11750, 2350},
+    {11450, 2250}, {11380, 2250}, {11300, 2180}, {11150, 2050}, {11120, 1800},
+    {10850, 1800}, {10860, 2150},
+    // Vietnam, Laos, Myanmar, India, Bhutan and Nepal
+    {10800, 2150}, {10670, 2230}, {10400, 2260}, {10220, 2240}, {10120, 2120},
+    {9920, 2210}, {9850, 2400}, {9760, 2480}, {9860, 2750}, {9740, 2830},
+    {9500, 2920}, {9200, 2790}, {8950, 2820}, {8800, 2810}, {8600, 2820},
+    {8400, 2930}, {8150, 3040}, {8020, 3030},
+    // Aksai Chin, Pakistan and Central Asia
+    {7880, 3150}, {7940, 3250}, {7880, 3330}, {7950, 3450}, {7780, 3560},
+    {7580, 3660}, {7490, 3720}, {7470, 3850}, {7360, 3950}, {7550, 4060},
+    {7680, 4100}, {7850, 4160}, {8020, 4220}, {8030, 4500}, {8250, 4550},
+    {8300, 4720}, {8550, 4700}
+};
+
+/**
+ * No frequency plan we can be sure is legal, so don't transmit
+ */
+static const geo_point_t pakistan[] = {
+    {6160, 2500}, {6175, 2580}, {6280, 2640}, {6330, 2670}, {6280, 2730},
+    {6280, 2820}, {6150, 2900}, {6090, 2985}, {6250, 2940}, {6450, 2950},
+    {6630, 2990}, {6660, 3100}, {6760, 3140}, {6880, 3160}, {6930, 3190},
+    {7000, 3300}, {6990, 3400}, {7110, 3440}, {7150, 3520}, {7130, 3600},
+    {7250, 3680}, {7400, 3690}, {7490, 3720}, {7580, 3660}, {7780, 3560},
+    // India, the same vertices as below
+    {7550, 3500}, {7420, 3450}, {7390, 3380}, {7430, 3300}, {7468, 3248},
+    {7457, 3160}, {7452, 3095}, {7390, 3040}, {7340, 2995}, {7200, 2890},
+    {7070, 2800}, {7000, 2780}, {6950, 2660}, {7010, 2570}, {7110, 2460},
+    {7100, 2410}, {6880, 2410}, {6820, 2360},
+    // Arabian Sea
+    {6700, 2450}, {6600, 2500}, {6400, 2500}
+};
+
+/**
+ * Land between the European and Asian plans: Iran east of 60E, Afghanistan,
+ * Central Asia and Mongolia. Nothing we can be sure is legal, and the edges
+ * run inside Pakistan, Russia and China so it only has to be right where it
+ * meets India and the Asia-Pacific box.
+ */
+static const geo_point_t central_asia[] = {
+    {6000, 2500}, {6160, 2500},
+    // Pakistan, India and China
+    {7490, 3720}, {8000, 3700}, {9500, 4000}, {12000, 4100},
+    // Russia
+    {12000, 5600}, {6000, 5600}
+};
+
+/**
+ * South of the DMZ, leaving Tsushima to Japan
+ */
+static const geo_point_t korea[] = {
+    {12500, 3450}, {12550, 3750}, {12600, 3775}, {12680, 3790}, {12730, 3830},
+    {12800, 3830}, {12835, 3862}, {13200, 3862}, {13200, 3690}, {12950, 3530},
+    {12870, 3450}, {12700, 3300}, {12600, 3300}
+};
+
+/**
+ * North of the DMZ to the Chinese fence, sharing the DMZ with korea
+ */
+static const geo_point_t north_korea[] = {
+    {12400, 3990}, {13070, 4240}, {13000, 4100}, {12900, 4000}, {12835, 3862},
+    {12800, 3830}, {12730, 3830}, {12680, 3790}, {12600, 3775}, {12550, 3750},
+    {12450, 3750}
+};
+
+static const geo_point_t india[] = {
+    {6820, 2360}, {6880, 2410}, {7100, 2410}, {7110, 2460}, {7010, 2570},
+    {6950, 2660}, {7000, 2780}, {7070, 2800}, {7200, 2890}, {7340, 2995},
+    {7390, 3040}, {7452, 3095}, {7457, 3160}, {7468, 3248}, {7430, 3300},
+    {7390, 3380}, {7420, 3450}, {7550, 3500}, {7780, 3560}, {7950, 3450},
+    {7880, 3330}, {7940, 3250}, {7880, 3150}, {8020, 3030}, {8800, 2700},
+    {9700, 2800}, {9200, 2100}, {8000, 600}, {7600, 800}
+};
+
+static const geo_point_t asia_pacific[] = {
+    {9200, -1100}, {15000, -1100}, {15000, 4600}, {9200, 4600}
+};
+
+static const geo_point_t oceania[] = {
+    {11200, -4800}, {17999, -4800}, {17999, -1000}, {11200, -1000}
+};
+
+static const geo_point_t south_america[] = {
+    {-8200, 1300}, {-6000, 1300}, {-3400, -500}, {-4000, -2500}, {-6500, -5600},
+    {-7600, -5600}, {-8200, -500}
+};
+
+static const geo_point_t north_america[] = {
+    {-17000, 700}, {-5000, 700}, {-5000, 7500}, {-17000, 7500}
+};
+
+static const geo_point_t europe_africa[] = {
+    {-3000, -4000}, {6000, -4000}, {6000, 7500}, {-3000, 7500}
+};
+
+struct geofence_t {
+    lora_region_t region;
+    uint8_t num_points;
+    const geo_point_t *points;
+};
+
+static const geofence_t geofences[] = {
+    {REGION_NO_GO, ARRAY_SIZE(russia), russia},
+    {REGION_NO_GO, ARRAY_SIZE(russia_east), russia_east},
+    {REGION_NO_GO, ARRAY_SIZE(kaliningrad), kaliningrad},
+    {REGION_NO_GO, ARRAY_SIZE(china), china},
+    {REGION_NO_GO, ARRAY_SIZE(pakistan), pakistan},
+    {REGION_KR920, ARRAY_SIZE(korea), korea},
+    {REGION_NO_GO, ARRAY_SIZE(north_korea), north_korea},
+    {REGION_IN865, ARRAY_SIZE(india), india},
+    {REGION_NO_GO, ARRAY_SIZE(central_asia), central_asia},
+    {REGION_AS923, ARRAY_SIZE(asia_pacific), asia_pacific},
+    {REGION_AU915, ARRAY_SIZE(oceania), oceania},
+    {REGION_AU915, ARRAY_SIZE(south_america), south_america},
+    {REGION_US915, ARRAY_SIZE(north_america), north_america},
+    {REGION_EU868, ARRAY_SIZE(europe_africa), europe_africa}
+};
+
+/**
+ * Even-odd point in polygon test, all integer so it's deterministic
+ */
+static bool inside(const geofence_t &fence, int32_t lat, int32_t lon) {
+    bool in = false;
+    for (uint8_t i = 0, j = fence.num_points - 1; i < fence.num_points; j = i++) {
+        int32_t xi = fence.points[i].lon, yi = fence.points[i].lat;
+        int32_t xj = fence.points[j].lon, yj = fence.points[j].lat;
+
+        if ((yi > lat) == (yj > lat))
+            continue;
+
+        // lon < crossing point of the edge, without dividing
+        int32_t lhs = (lon - xi) * (yj - yi);
+        int32_t rhs = (lat - yi) * (xj - xi);
+        if ((yj > yi) ? (lhs < rhs) : (lhs > rhs))
+            in = !in;
+    }
+    return in;
+}
+
+static_assert(PAYLOAD_MAX_LEN <= 51, "payload doesn't fit the slowest datarates in region_datarate()");
+
+lora_region_t region_lookup(int32_t lat_cdeg, int32_t lon_cdeg) {
+    for (uint8_t i = 0; i < ARRAY_SIZE(geofences); i++) {
+        if (inside(geofences[i], lat_cdeg, lon_cdeg))
+            return geofences[i].region;
+    }
+    return REGION_UNKNOWN;
+}
+
+/**
+ * Lookup using the 24 bit lat/lon from the payload encoding
+ */
+lora_region_t region_lookup_packed(uint32_t lat, uint32_t lon) {
+    int32_t lat_cdeg = (int32_t)(((uint64_t)lat * 18000 + 0x7FFFFF) / 0xFFFFFF) - 9000;
+    int32_t lon_cdeg = (int32_t)(((uint64_t)lon * 36000 + 0x7FFFFF) / 0xFFFFFF) - 18000;
+    return region_lookup(lat_cdeg, lon_cdeg);
+}
+
+const char *region_name(lora_region_t region) {
+    switch (region) {
+        case REGION_NO_GO:
+            return "NO-GO";
+        case REGION_EU868:
+            return "EU868";
+        case REGION_US915:
+            return "US915";
+        case REGION_AU915:
+            return "AU915";
+        case REGION_AS923:
+            return "AS923";
+        case REGION_IN865:
+            return "IN865";
+        case REGION_KR920:
+            return "KR920";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+/**
+ * Slowest datarate in each plan that still fits a full keyframe. The stack
+ * cuts longer payloads short without an error, so DR0 isn't always usable:
+ * US915 DR0 and AS923 with dwell time limits only carry 11 bytes.
+ */
+region_datarate_t region_datarate(lora_region_t region) {
+    switch (region) {
+        case REGION_US915:
+            return {1, 53};     // SF9
+        case REGION_AU915:
+        case REGION_AS923:
+            return {3, 53};     // SF9, DR2 is 11 bytes with dwell time limits
+        case REGION_EU868:
+        case REGION_IN865:
+        case REGION_KR920:
+        default:
+            return {0, 51};     // SF12
+    }
+}
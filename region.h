@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * LoRaWAN frequency plans we can switch between at runtime
+ */
+enum lora_region_t {
+    REGION_UNKNOWN = 0,     // open ocean, not covered by any geofence, keep the current plan
+    REGION_NO_GO,           // don't transmit at all
+    REGION_EU868,
+    REGION_US915,
+    REGION_AU915,
+    REGION_AS923,
+    REGION_IN865,
+    REGION_KR920
+};
+
+/**
+ * Geofence vertex in hundredths of a degree
+ */
+struct geo_point_t {
+    int16_t lon;
+    int16_t lat;
+};
+
+/**
+ * Uplink settings for a plan
+ */
+struct region_datarate_t {
+    uint8_t datarate;       // DR index in the plan
+    uint8_t max_payload;    // bytes, largest application payload at that DR
+};
+
+lora_region_t region_lookup(int32_t lat_cdeg, int32_t lon_cdeg);
+lora_region_t region_lookup_packed(uint32_t lat, uint32_t lon);
+const char *region_name(lora_region_t region);
+region_datarate_t region_datarate(lora_region_t region);
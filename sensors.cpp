@@ -0,0 +1,48 @@
+#include "sensors.h"
+
+#include "mbed.h"
+#include "board_profile.h"
+#include "BMP280.h"
+
+/**
+ * ADC Pin to measure battery voltage
+ */
+static AnalogIn voltage(Board::battery_adc);
+
+/**
+ * Read the BMP280 into the telemetry
+ */
+void read_bmp280(telemetry_t &t) {
+    float raw_temp;
+
+    if (!Board::has_bmp280) {
+        return;
+    }
+
+    sleep_manager_lock_deep_sleep();
+
+    /**
+     * BMP280 I2C
+     */
+    BMP280 bmp280(Board::bmp280_sda, Board::bmp280_scl, Board::bmp280_address);
+    bmp280.initialize();
+    
+    raw_temp = bmp280.getTemperature();
+    t.pressure = bmp280.getPressure();
+    t.temp = int(raw_temp * 10 + 0.5) + 128; // Encode the temperature to avoid negatives.
+
+    bmp280.deInit();
+    sleep_manager_unlock_deep_sleep();
+}
+
+/**
+ * Read the battery voltage into the telemetry
+ */
+void read_battery(telemetry_t &t) {
+    float raw_adc;
+    float calc_voltage;
+
+    raw_adc = voltage.read();
+    calc_voltage = (Board::adc_reference*raw_adc*Board::battery_divider);
+    t.battery = (calc_voltage - 2)*(255/2.3f);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "payload.h"
+
+/**
+ * Readings from the sensors on the board. Boards without a sensor, see
+ * board_profile.h, leave its fields as they are.
+ */
+void read_bmp280(telemetry_t &t);
+void read_battery(telemetry_t &t);
@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+"""
+RAM and flash breakdown from a GNU ld map file.
+
+Sizes are attributed to modules (object files, grouped by path depth) and
+to symbols (input section names, so build with -ffunction-sections and
+-fdata-sections, which Mbed OS does). Output sections are classed as
+flash or RAM from the memory regions in the map; initialised data counts
+towards both.
+
+    footprint.py app.map                         print the breakdown
+    footprint.py app.map --save baseline.json    store it as a baseline
+    footprint.py app.map --baseline baseline.json
+                                                 print what changed
+"""
+
+import argparse
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+SECTION_PREFIXES = (".text.", ".rodata.", ".data.", ".bss.", ".tbss.", ".tdata.")
+
+MEMORY_RE = re.compile(r"^(\S+)\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s*(\S*)")
+OUTPUT_RE = re.compile(r"^(\.\S+)\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)(\s+load address\s+(0x[0-9a-fA-F]+))?")
+INPUT_RE = re.compile(r"^ (\.\S+|COMMON)\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(\S.*)$")
+INPUT_NAME_RE = re.compile(r"^ (\.\S+|COMMON)\s*$")
+INPUT_CONT_RE = re.compile(r"^\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(\S.*)$")
+
+
+def module_name(path, depth):
+    """Shorten an object path to a module name"""
+    archive = re.match(r"^(.*)\((.*)\)$", path)
+    if archive:
+        path = archive.group(2) if os.path.sep in archive.group(2) else \
+            os.path.join(os.path.dirname(archive.group(1)), archive.group(2))
+    path = re.sub(r"CMakeFiles/[^/]+\.dir/", "", path)
+    path = re.sub(r"\.(obj|o)$", "", path)
+    parts = [p for p in path.split("/") if p not in ("", ".", "..")]
+    if depth > 0 and len(parts) > depth:
+        parts = parts[:depth]
+    return "/".join(parts)
+
+
+def classify_by_name(section):
+    """(flash, ram) for maps without usable memory regions"""
+    if section.startswith((".bss", ".noinit", ".heap", ".stack", ".tbss")):
+        return (False, True)
+    if section.startswith((".data", ".tdata")):
+        return (True, True)
+    return (True, False)
+
+
+def symbol_name(section):
+    for prefix in SECTION_PREFIXES:
+        if section.startswith(prefix):
+            return section[len(prefix):]
+    return None
+
+
+def parse_map(path, depth):
+    regions = []
+    modules = {}
+    symbols = {}
+    current = None  # (flash, ram) for the output section we're in
+    pending = None
+
+    with open(path, errors="replace") as f:
+        lines = f.read().splitlines()
+
+    in_memory = False
+    in_layout = False
+    for line in lines:
+        if line.startswith("Memory Configuration"):
+            in_memory = True
+            continue
+        if line.startswith("Linker script and memory map"):
+            in_memory = False
+            in_layout = True
+            continue
+        if in_memory:
+            m = MEMORY_RE.match(line)
+            if m and m.group(1) not in ("Name", "*default*"):
+                attrs = m.group(4)
+                regions.append((int(m.group(2), 16), int(m.group(3), 16),
+                                "w" not in attrs and "x" in attrs))
+            continue
+        if not in_layout:
+            continue
+
+        m = OUTPUT_RE.match(line)
+        if m:
+            vma = int(m.group(2), 16)
+            region = next((r for r in regions if r[0] <= vma < r[0] + r[1]), None)
+            if int(m.group(3), 16) == 0 or (vma == 0 and region is None):
+                current = None
+            elif region is not None:
+                in_flash = region[2]
+                current = (in_flash or m.group(4) is not None, not in_flash)
+            else:
+                current = classify_by_name(m.group(1))
+            pending = None
+            continue
+
+        if current is None:
+            continue
+
+        m = INPUT_RE.match(line)
+        if m:
+            section, size, obj = m.group(1), int(m.group(3), 16), m.group(4)
+        else:
+            m = INPUT_NAME_RE.match(line)
+            if m:
+                pending = m.group(1)
+                continue
+            m = INPUT_CONT_RE.match(line)
+            if not m or pending is None:
+                continue
+            section, size, obj = pending, int(m.group(2), 16), m.group(3)
+            pending = None
+
+        if size == 0 or obj.startswith("load address"):
+            continue
+
+        flash = size if current[0] else 0
+        ram = size if current[1] else 0
+        name = module_name(obj, depth)
+        mod = modules.setdefault(name, [0, 0])
+        mod[0] += flash
+        mod[1] += ram
+
+        sym = symbol_name(section)
+        if sym:
+            entry = symbols.setdefault(sym, [0, 0, name])
+            entry[0] += flash
+            entry[1] += ram
+
+    demangle(symbols)
+    return {
+        "flash": sum(m[0] for m in modules.values()),
+        "ram": sum(m[1] for m in modules.values()),
+        "modules": modules,
+        "symbols": symbols,
+    }
+
+
+def demangle(symbols):
+    """Demangle C++ names in place if c++filt is around"""
+    tool = shutil.which("arm-none-eabi-c++filt") or shutil.which("c++filt")
+    mangled = [s for s in symbols if s.startswith("_Z")]
+    if not tool or not mangled:
+        return
+    try:
+        out = subprocess.run([tool], input="\n".join(mangled), capture_output=True,
+                             text=True, check=True).stdout.splitlines()
+    except (OSError, subprocess.CalledProcessError):
+        return
+    for old, new in zip(mangled, out):
+        entry = symbols.pop(old)
+        if new in symbols:
+            symbols[new][0] += entry[0]
+            symbols[new][1] += entry[1]
+        else:
+            symbols[new] = entry
+
+
+def print_table(title, rows, limit):
+    print("\n%s" % title)
+    print("%-60s %10s %10s" % ("", "flash", "ram"))
+    for name, flash, ram in rows[:limit]:
+        print("%-60s %10d %10d" % (name[:60], flash, ram))
+
+
+def print_report(report, limit):
+    modules = sorted(((n, v[0], v[1]) for n, v in report["modules"].items()),
+                     key=lambda r: r[1] + r[2], reverse=True)
+    symbols = sorted(((n, v[0], v[1]) for n, v in report["symbols"].items()),
+                     key=lambda r: r[1] + r[2], reverse=True)
+    print_table("Modules", modules, limit)
+    print_table("Symbols", symbols, limit)
+    print("\nTotal flash: %d bytes, RAM: %d bytes" % (report["flash"], report["ram"]))
+
+
+def print_diff(report, baseline, limit):
+    def changes(key):
+        rows = []
+        now, then = report[key], baseline.get(key, {})
+        for name in set(now) | set(then):
+            a = then.get(name, [0, 0])
+            b = now.get(name, [0, 0])
+            if a[0] != b[0] or a[1] != b[1]:
+                rows.append((name, b[0] - a[0], b[1] - a[1]))
+        return sorted(rows, key=lambda r: abs(r[1]) + abs(r[2]), reverse=True)
+
+    print_table("Module changes", changes("modules"), limit)
+    print_table("Symbol changes", changes("symbols"), limit)
+    print("\nTotal flash: %d bytes (%+d), RAM: %d bytes (%+d)" % (
+        report["flash"], report["flash"] - baseline.get("flash", 0),
+        report["ram"], report["ram"] - baseline.get("ram", 0)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("map", help="GNU ld map file")
+    parser.add_argument("-d", "--depth", type=int, default=3,
+                        help="path components to group modules by, 0 for full paths")
+    parser.add_argument("-n", "--limit", type=int, default=30, help="rows per table")
+    parser.add_argument("--save", help="write the breakdown to this JSON file")
+    parser.add_argument("--baseline", help="compare against this JSON file")
+    args = parser.parse_args()
+
+    report = parse_map(args.map, args.depth)
+    if not report["modules"]:
+        print("No sections found in %s" % args.map, file=sys.stderr)
+        return 1
+
+    if args.baseline and os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            print_diff(report, json.load(f), args.limit)
+    else:
+        if args.baseline:
+            print("No baseline at %s, use --save to create one" % args.baseline)
+        print_report(report, args.limit)
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(report, f, indent=1, sort_keys=True)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,709 @@
+/**
+ * Ground station ingest for tracker uplinks.
+ *
+ * Streams newline delimited JSON uplink records (network server exports,
+ * one uplink per gateway per line) from a file or stdin, decodes the
+ * payloads from payload.cpp, drops the copies heard by more than one
+ * gateway and rebuilds a track per device.
+ *
+ * Only a handful of keys are read from each record, wherever they appear:
+ *   "device_id", "f_port", "f_cnt", "frm_payload" (base64), "received_at"
+ *
+ * The output is columnar, all integers little endian:
+ *   "PBTRACK3", u32 device count, then per device
+ *   u16 name length, name, u32 rows, then each column for all rows:
+ *   i64 time ms, u32 fcnt, u8 port,
+ *   u8 flags (bit 0 fix, bit 1 stale, bits 2-3 fix quality),
+ *   i32 lat 1e-6 deg, i32 lon 1e-6 deg, u16 altitude m, u8 speed km/h,
+ *   u8 sats, u8 battery, u32 pressure Pa, u16 temp (0.1 C + 128),
+ *   u16 stack high-water mark, u16 heap high-water mark (0 if not sent),
+ *   u8 event queue peak occupancy %, u8 failed event posts (0 if not sent)
+ *
+ * --generate writes synthetic input made with the firmware encoder, for
+ * benchmarking. Throughput and peak memory are reported on stderr.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "payload.h"
+
+#define BLOCK_SIZE          (4 * 1024 * 1024)
+#define NUM_SHARDS          64
+#define DUPLICATE_WINDOW_MS (60 * 1000)
+
+#define FLAG_FIX            (1 << 0)
+#define FLAG_STALE          (1 << 1)
+#define FLAG_QUALITY_SHIFT  2
+
+/**
+ * One uplink as heard by one gateway
+ */
+struct Record {
+    int64_t time_ms;
+    uint32_t fcnt;
+    uint8_t port;
+    uint8_t len;
+    uint8_t payload[PAYLOAD_MAX_LEN];
+};
+
+/**
+ * Devices are spread over shards by name so workers rarely contend
+ */
+struct Shard {
+    std::mutex lock;
+    std::unordered_map<std::string, uint32_t> index;
+    std::vector<std::string> names;
+    std::vector<std::vector<Record>> records;
+};
+
+struct Track {
+    std::string name;
+    std::vector<int64_t> time_ms;
+    std::vector<uint32_t> fcnt;
+    std::vector<uint8_t> port;
+    std::vector<uint8_t> flags;
+    std::vector<int32_t> lat;
+    std::vector<int32_t> lon;
+    std::vector<uint16_t> altitude;
+    std::vector<uint8_t> speed;
+    std::vector<uint8_t> sats;
+    std::vector<uint8_t> battery;
+    std::vector<uint32_t> pressure;
+    std::vector<uint16_t> temp;
+    std::vector<uint16_t> stack_max;
+    std::vector<uint16_t> heap_max;
+    std::vector<uint8_t> evq_peak;
+    std::vector<uint8_t> evq_failures;
+};
+
+static std::atomic<uint64_t> lines_read(0);
+static std::atomic<uint64_t> lines_rejected(0);
+static std::atomic<uint64_t> duplicates(0);
+static std::atomic<uint64_t> undecodable(0);
+
+/**
+ * Bounded queue of input blocks between the reader and the workers
+ */
+class BlockQueue {
+public:
+    explicit BlockQueue(size_t limit) : _limit(limit), _closed(false) {}
+
+    void push(std::string &&block) {
+        std::unique_lock<std::mutex> l(_lock);
+        _not_full.wait(l, [this] { return _blocks.size() < _limit; });
+        _blocks.push_back(std::move(block));
+        _not_empty.notify_one();
+    }
+
+    bool pop(std::string &block) {
+        std::unique_lock<std::mutex> l(_lock);
+        _not_empty.wait(l, [this] { return !_blocks.empty() || _closed; });
+        if (_blocks.empty())
+            return false;
+        block = std::move(_blocks.front());
+        _blocks.pop_front();
+        _not_full.notify_one();
+        return true;
+    }
+
+    void close(void) {
+        std::lock_guard<std::mutex> l(_lock);
+        _closed = true;
+        _not_empty.notify_all();
+    }
+
+private:
+    size_t _limit;
+    bool _closed;
+    std::deque<std::string> _blocks;
+    std::mutex _lock;
+    std::condition_variable _not_full;
+    std::condition_variable _not_empty;
+};
+
+/**
+ * Find the value following "key": in a JSON line. Strings are returned
+ * without quotes, anything else up to the next delimiter.
+ */
+static bool json_field(std::string_view line, std::string_view key, std::string_view &value) {
+    size_t pos = 0;
+    while ((pos = line.find(key, pos)) != std::string_view::npos) {
+        size_t start = pos;
+        pos += key.size();
+        if (start == 0 || line[start - 1] != '"' || pos >= line.size() || line[pos] != '"')
+            continue;
+        pos++;
+        while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t'))
+            pos++;
+        if (pos >= line.size() || line[pos] != ':')
+            continue;
+        pos++;
+        while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t'))
+            pos++;
+        if (pos >= line.size())
+            return false;
+        if (line[pos] == '"') {
+            size_t end = line.find('"', pos + 1);
+            if (end == std::string_view::npos)
+                return false;
+            value = line.substr(pos + 1, end - pos - 1);
+        } else {
+            size_t end = line.find_first_of(",}] \t\r", pos);
+            if (end == std::string_view::npos)
+                end = line.size();
+            value = line.substr(pos, end - pos);
+        }
+        return true;
+    }
+    return false;
+}
+
+static bool parse_uint(std::string_view s, uint32_t &out) {
+    uint64_t v = 0;
+    if (s.empty() || s.size() > 10)
+        return false;
+    for (char c : s) {
+        if (c < '0' || c > '9')
+            return false;
+        v = v * 10 + (c - '0');
+    }
+    if (v > 0xFFFFFFFF)
+        return false;
+    out = v;
+    return true;
+}
+
+static int8_t base64_value(char c) {
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '+' || c == '-')
+        return 62;
+    if (c == '/' || c == '_')
+        return 63;
+    return -1;
+}
+
+static bool base64_decode(std::string_view in, uint8_t *out, uint8_t size, uint8_t &len) {
+    uint32_t acc = 0;
+    int bits = 0;
+    len = 0;
+    for (char c : in) {
+        if (c == '=')
+            break;
+        int8_t v = base64_value(c);
+        if (v < 0)
+            return false;
+        acc = (acc << 6) | v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (len >= size)
+                return false;
+            out[len++] = (acc >> bits) & 0xFF;
+        }
+    }
+    return true;
+}
+
+static const char base64_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static std::string base64_encode(const uint8_t *in, uint8_t len) {
+    std::string out;
+    for (uint8_t i = 0; i < len; i += 3) {
+        uint32_t n = in[i] << 16;
+        if (i + 1 < len)
+            n |= in[i + 1] << 8;
+        if (i + 2 < len)
+            n |= in[i + 2];
+        out += base64_chars[(n >> 18) & 0x3F];
+        out += base64_chars[(n >> 12) & 0x3F];
+        out += (i + 1 < len) ? base64_chars[(n >> 6) & 0x3F] : '=';
+        out += (i + 2 < len) ? base64_chars[n & 0x3F] : '=';
+    }
+    return out;
+}
+
+/**
+ * Days between 1970-01-01 and a civil date
+ */
+static int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned)(y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+static void civil_from_days(int64_t z, int &y, unsigned &m, unsigned &d) {
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned)(z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = (int)(yoe + era * 400 + (m <= 2));
+}
+
+static bool digits(std::string_view s, size_t pos, size_t n, unsigned &out) {
+    if (pos + n > s.size())
+        return false;
+    out = 0;
+    for (size_t i = pos; i < pos + n; i++) {
+        if (s[i] < '0' || s[i] > '9')
+            return false;
+        out = out * 10 + (s[i] - '0');
+    }
+    return true;
+}
+
+/**
+ * Parse an RFC 3339 UTC timestamp, e.g. 2021-06-01T12:34:56.123456Z
+ */
+static bool parse_time(std::string_view s, int64_t &time_ms) {
+    unsigned year, month, day, hour, minute, second, ms = 0;
+    if (!digits(s, 0, 4, year) || !digits(s, 5, 2, month) || !digits(s, 8, 2, day)
+            || !digits(s, 11, 2, hour) || !digits(s, 14, 2, minute) || !digits(s, 17, 2, second))
+        return false;
+    if (s.size() > 19 && s[19] == '.') {
+        unsigned scale = 100;
+        for (size_t i = 20; i < s.size() && s[i] >= '0' && s[i] <= '9'; i++) {
+            ms += (s[i] - '0') * scale;
+            scale /= 10;
+        }
+    }
+    int64_t days = days_from_civil(year, month, day);
+    time_ms = ((days * 24 + hour) * 60 + minute) * 60 * 1000 + second * 1000 + ms;
+    return true;
+}
+
+static std::string format_time(int64_t time_ms) {
+    int64_t days = time_ms / 86400000;
+    int64_t rem = time_ms % 86400000;
+    int y;
+    unsigned m, d;
+    civil_from_days(days, y, m, d);
+    char buf[64];   // fits the widest values, not just real dates
+    snprintf(buf, sizeof(buf), "%04d-%02u-%02uT%02u:%02u:%02u.%03uZ", y, m, d,
+             (unsigned)(rem / 3600000), (unsigned)(rem / 60000 % 60),
+             (unsigned)(rem / 1000 % 60), (unsigned)(rem % 1000));
+    return buf;
+}
+
+static uint32_t fnv1a(std::string_view s) {
+    uint32_t h = 2166136261u;
+    for (char c : s) {
+        h ^= (uint8_t)c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static bool parse_record(std::string_view line, std::string_view &device, Record &r) {
+    std::string_view value;
+
+    if (!json_field(line, "device_id", device))
+        return false;
+    if (!json_field(line, "f_port", value))
+        return false;
+    uint32_t port;
+    if (!parse_uint(value, port) || port > 255)
+        return false;
+    r.port = port;
+
+    // Zero values are left out of some exports
+    r.fcnt = 0;
+    if (json_field(line, "f_cnt", value) && !parse_uint(value, r.fcnt))
+        return false;
+
+    if (!json_field(line, "frm_payload", value))
+        return false;
+    if (!base64_decode(value, r.payload, sizeof(r.payload), r.len))
+        return false;
+
+    r.time_ms = 0;
+    if (json_field(line, "received_at", value) && !parse_time(value, r.time_ms))
+        return false;
+    return true;
+}
+
+struct Pending {
+    std::string_view device;
+    Record record;
+};
+
+/**
+ * Parse blocks of lines and hand the records to their device's shard
+ */
+static void parse_worker(BlockQueue &queue, std::vector<Shard> &shards) {
+    std::string block;
+    std::vector<std::vector<Pending>> pending(shards.size());
+
+    while (queue.pop(block)) {
+        std::string_view view(block);
+        uint64_t lines = 0;
+        uint64_t rejected = 0;
+        size_t pos = 0;
+
+        while (pos < view.size()) {
+            size_t end = view.find('\n', pos);
+            if (end == std::string_view::npos)
+                end = view.size();
+            std::string_view line = view.substr(pos, end - pos);
+            pos = end + 1;
+            if (line.empty())
+                continue;
+
+            lines++;
+            Pending p;
+            if (!parse_record(line, p.device, p.record)) {
+                rejected++;
+                continue;
+            }
+            pending[fnv1a(p.device) % shards.size()].push_back(p);
+        }
+
+        for (size_t i = 0; i < shards.size(); i++) {
+            if (pending[i].empty())
+                continue;
+            Shard &shard = shards[i];
+            std::lock_guard<std::mutex> l(shard.lock);
+            for (const Pending &p : pending[i]) {
+                auto it = shard.index.find(std::string(p.device));
+                uint32_t dev;
+                if (it == shard.index.end()) {
+                    dev = shard.names.size();
+                    shard.index.emplace(std::string(p.device), dev);
+                    shard.names.emplace_back(p.device);
+                    shard.records.emplace_back();
+                } else {
+                    dev = it->second;
+                }
+                shard.records[dev].push_back(p.record);
+            }
+            pending[i].clear();
+        }
+
+        lines_read += lines;
+        lines_rejected += rejected;
+    }
+}
+
+/**
+ * Drop gateway duplicates and decode one device's uplinks in order
+ */
+static void build_track(const std::string &name, std::vector<Record> &records, Track &track) {
+    // Same frame counter and payload within a short window is the same uplink
+    std::sort(records.begin(), records.end(), [](const Record &a, const Record &b) {
+        return a.fcnt != b.fcnt ? a.fcnt < b.fcnt : a.time_ms < b.time_ms;
+    });
+    size_t kept = 0;
+    for (size_t i = 0; i < records.size(); i++) {
+        if (kept > 0) {
+            const Record &prev = records[kept - 1];
+            const Record &r = records[i];
+            if (prev.fcnt == r.fcnt && prev.port == r.port && prev.len == r.len
+                    && !memcmp(prev.payload, r.payload, r.len)
+                    && r.time_ms - prev.time_ms < DUPLICATE_WINDOW_MS) {
+                continue;
+            }
+        }
+        records[kept++] = records[i];
+    }
+    duplicates += records.size() - kept;
+    records.resize(kept);
+    records.shrink_to_fit();
+
+    // Frame counters restart on rejoin, so decode in time order
+    std::stable_sort(records.begin(), records.end(), [](const Record &a, const Record &b) {
+        return a.time_ms < b.time_ms;
+    });
+
+    PayloadDecoder decoder;
+    track.name = name;
+    for (const Record &r : records) {
+        telemetry_t t;
+        if (!decoder.decode(r.port, r.payload, r.len, r.fcnt, t)) {
+            undecodable++;
+            continue;
+        }
+        track.time_ms.push_back(r.time_ms);
+        track.fcnt.push_back(r.fcnt);
+        track.port.push_back(r.port);
+        track.flags.push_back((t.has_fix ? FLAG_FIX : 0) | (decoder.is_stale() ? FLAG_STALE : 0)
+                              | (t.has_fix ? t.quality << FLAG_QUALITY_SHIFT : 0));
+        track.lat.push_back(t.has_fix ? lround(payload_unpack_lat(t.lat) * 1e6) : 0);
+        track.lon.push_back(t.has_fix ? lround(payload_unpack_lon(t.lon) * 1e6) : 0);
+        track.altitude.push_back(t.altitude);
+        track.speed.push_back(t.speed);
+        track.sats.push_back(t.sats);
+        track.battery.push_back(t.battery);
+        track.pressure.push_back(t.pressure);
+        track.temp.push_back(t.temp);
+        track.stack_max.push_back(t.has_mem_stats ? t.stack_max : 0);
+        track.heap_max.push_back(t.has_mem_stats ? t.heap_max : 0);
+        track.evq_peak.push_back(t.has_evq_stats ? t.evq_peak : 0);
+        track.evq_failures.push_back(t.has_evq_stats ? t.evq_failures : 0);
+    }
+}
+
+template <typename T>
+static void write_column(FILE *out, const std::vector<T> &column) {
+    // Little endian hosts only, which is everything we run this on
+    fwrite(column.data(), sizeof(T), column.size(), out);
+}
+
+static bool write_tracks(FILE *out, const std::vector<Track> &tracks) {
+    uint32_t count = tracks.size();
+    fwrite("PBTRACK3", 1, 8, out);
+    fwrite(&count, sizeof(count), 1, out);
+    for (const Track &t : tracks) {
+        uint16_t name_len = t.name.size();
+        uint32_t rows = t.time_ms.size();
+        fwrite(&name_len, sizeof(name_len), 1, out);
+        fwrite(t.name.data(), 1, name_len, out);
+        fwrite(&rows, sizeof(rows), 1, out);
+        write_column(out, t.time_ms);
+        write_column(out, t.fcnt);
+        write_column(out, t.port);
+        write_column(out, t.flags);
+        write_column(out, t.lat);
+        write_column(out, t.lon);
+        write_column(out, t.altitude);
+        write_column(out, t.speed);
+        write_column(out, t.sats);
+        write_column(out, t.battery);
+        write_column(out, t.pressure);
+        write_column(out, t.temp);
+        write_column(out, t.stack_max);
+        write_column(out, t.heap_max);
+        write_column(out, t.evq_peak);
+        write_column(out, t.evq_failures);
+    }
+    return !ferror(out);
+}
+
+static int ingest(FILE *in, FILE *out, unsigned threads) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<Shard> shards(NUM_SHARDS);
+    BlockQueue queue(threads * 2);
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < threads; i++)
+        workers.emplace_back(parse_worker, std::ref(queue), std::ref(shards));
+
+    // Cut the input into blocks on line boundaries
+    std::string carry;
+    std::vector<char> buf(BLOCK_SIZE);
+    size_t n;
+    while ((n = fread(buf.data(), 1, buf.size(), in)) > 0) {
+        std::string block = std::move(carry);
+        block.append(buf.data(), n);
+        size_t last = block.rfind('\n');
+        if (last == std::string::npos) {
+            carry = std::move(block);
+            continue;
+        }
+        carry = block.substr(last + 1);
+        block.resize(last + 1);
+        queue.push(std::move(block));
+    }
+    if (!carry.empty())
+        queue.push(std::move(carry));
+    queue.close();
+    for (std::thread &t : workers)
+        t.join();
+
+    // Rebuild the tracks a shard at a time in parallel
+    std::vector<std::vector<Track>> shard_tracks(shards.size());
+    std::atomic<size_t> next_shard(0);
+    workers.clear();
+    for (unsigned i = 0; i < threads; i++) {
+        workers.emplace_back([&] {
+            size_t s;
+            while ((s = next_shard++) < shards.size()) {
+                Shard &shard = shards[s];
+                shard_tracks[s].resize(shard.names.size());
+                for (size_t d = 0; d < shard.names.size(); d++) {
+                    build_track(shard.names[d], shard.records[d], shard_tracks[s][d]);
+                    std::vector<Record>().swap(shard.records[d]);
+                }
+            }
+        });
+    }
+    for (std::thread &t : workers)
+        t.join();
+
+    std::vector<Track> tracks;
+    for (std::vector<Track> &st : shard_tracks)
+        for (Track &t : st)
+            tracks.push_back(std::move(t));
+    std::sort(tracks.begin(), tracks.end(), [](const Track &a, const Track &b) {
+        return a.name < b.name;
+    });
+
+    uint64_t rows = 0;
+    for (const Track &t : tracks)
+        rows += t.time_ms.size();
+
+    if (!write_tracks(out, tracks)) {
+        fprintf(stderr, "Failed to write output\n");
+        return 1;
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    fprintf(stderr, "records:      %llu (%llu rejected)\n",
+            (unsigned long long)lines_read, (unsigned long long)lines_rejected);
+    fprintf(stderr, "duplicates:   %llu\n", (unsigned long long)duplicates);
+    fprintf(stderr, "undecodable:  %llu\n", (unsigned long long)undecodable);
+    fprintf(stderr, "devices:      %zu\n", tracks.size());
+    fprintf(stderr, "track points: %llu\n", (unsigned long long)rows);
+    fprintf(stderr, "threads:      %u\n", threads);
+    fprintf(stderr, "elapsed:      %.3f s\n", elapsed);
+    fprintf(stderr, "throughput:   %.0f records/s\n", elapsed > 0 ? lines_read / elapsed : 0);
+    fprintf(stderr, "peak memory:  %.1f MiB\n", usage.ru_maxrss / 1024.0);
+    return 0;
+}
+
+/**
+ * Write synthetic uplinks for a fleet: a climb to float altitude and a
+ * slow drift, each frame heard by a random number of gateways.
+ */
+static int generate(FILE *out, uint64_t count, unsigned devices, unsigned gateways) {
+    const payload_precision_t precision = {5, 10, 2, 2, 8000};
+    std::vector<PayloadEncoder> encoders(devices, PayloadEncoder(10, precision));
+    std::mt19937 rng(1);
+    const int64_t start_ms = days_from_civil(2021, 6, 1) * 86400000LL;
+
+    uint64_t written = 0;
+    for (uint32_t frame = 0; written < count; frame++) {
+        for (unsigned d = 0; d < devices && written < count; d++) {
+            telemetry_t t = {};
+            double minutes = frame;
+            t.has_fix = (rng() % 20) != 0;
+            t.lat = payload_pack_lat(51.0 + 0.3 * d / devices + minutes * 0.0005);
+            t.lon = payload_pack_lon(-1.0 + minutes * 0.004);
+            t.altitude = std::min<uint32_t>(frame * 300, 12000) + (rng() % 20);
+            t.speed = std::min<uint32_t>(frame, 90);
+            t.sats = 6 + rng() % 4;
+            t.quality = 3;
+            t.battery = 200 - std::min<uint32_t>(frame / 50, 100);
+            t.pressure = 101325 * exp(-t.altitude / 7400.0);
+            t.temp = 128 + 200 - std::min<uint32_t>(frame * 10, 700);
+            t.has_mem_stats = true;
+            t.stack_max = 2400 + rng() % 200;
+            t.heap_max = 9000;
+            t.has_evq_stats = true;
+            t.evq_peak = 40 + rng() % 20;
+            t.evq_failures = 0;
+
+            uint8_t buf[PAYLOAD_MAX_LEN];
+            uint8_t port;
+            uint8_t len = encoders[d].encode(t, buf, sizeof(buf), port);
+            encoders[d].commit();
+
+            std::string payload = base64_encode(buf, len);
+            int64_t time_ms = start_ms + (int64_t)frame * 60000 + d * 250;
+            unsigned heard = 1 + rng() % gateways;
+            for (unsigned g = 0; g < heard && written < count; g++) {
+                fprintf(out, "{\"end_device_ids\":{\"device_id\":\"balloon-%04u\"},"
+                        "\"received_at\":\"%s\",\"uplink_message\":{\"f_port\":%u,"
+                        "\"f_cnt\":%u,\"frm_payload\":\"%s\",\"rx_metadata\":"
+                        "[{\"gateway_ids\":{\"gateway_id\":\"gw-%u\"}}]}}\n",
+                        d, format_time(time_ms + rng() % 500).c_str(), port, frame,
+                        payload.c_str(), (unsigned)(rng() % 1000));
+                written++;
+            }
+        }
+    }
+    return ferror(out) ? 1 : 0;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s [-j threads] [-o output] [input|-]\n"
+            "       %s --generate records [--devices n] [--gateways n] > input\n",
+            name, name);
+}
+
+int main(int argc, char **argv) {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    const char *input = "-";
+    const char *output = NULL;
+    uint64_t generate_count = 0;
+    unsigned devices = 50;
+    unsigned gateways = 4;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (!strcmp(arg, "-j") && has_value) {
+            threads = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(arg, "-o") && has_value) {
+            output = argv[++i];
+        } else if (!strcmp(arg, "--generate") && has_value) {
+            generate_count = strtoull(argv[++i], NULL, 10);
+        } else if (!strcmp(arg, "--devices") && has_value) {
+            devices = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(arg, "--gateways") && has_value) {
+            gateways = std::max(1, atoi(argv[++i]));
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            usage(argv[0]);
+            return 2;
+        } else {
+            input = arg;
+        }
+    }
+
+    if (generate_count)
+        return generate(stdout, generate_count, devices, gateways);
+
+    FILE *in = strcmp(input, "-") ? fopen(input, "rb") : stdin;
+    if (!in) {
+        fprintf(stderr, "Can't open %s\n", input);
+        return 1;
+    }
+    if (!output) {
+        usage(argv[0]);
+        return 2;
+    }
+    FILE *out = fopen(output, "wb");
+    if (!out) {
+        fprintf(stderr, "Can't open %s\n", output);
+        return 1;
+    }
+
+    int ret = ingest(in, out, threads);
+    if (in != stdin)
+        fclose(in);
+    if (fclose(out) != 0)
+        ret = 1;
+    return ret;
+}
@@ -0,0 +1,30 @@
+# Runs pb-ingest on the fixture and checks the output against the expected
+# track file byte for byte, and the counts it reports on stderr.
+#   cmake -DINGEST=... -DTHREADS=n -DINPUT=... -DEXPECTED=... -DOUTPUT=... -P run_ingest.cmake
+
+execute_process(
+    COMMAND ${INGEST} -j ${THREADS} -o ${OUTPUT} ${INPUT}
+    RESULT_VARIABLE result
+    ERROR_VARIABLE report
+)
+message("${report}")
+if(result)
+    message(FATAL_ERROR "pb-ingest failed: ${result}")
+endif()
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT} ${EXPECTED}
+    RESULT_VARIABLE differ
+)
+if(differ)
+    message(FATAL_ERROR "${OUTPUT} differs from ${EXPECTED}")
+endif()
+
+# 15 lines, one not base64; five gateway copies, the last copy of fcnt 2
+# comes after the window so it's a replay; the leading delta from
+# balloon-b has no keyframe to apply to
+foreach(line "records: +15 \\(1 rejected\\)" "duplicates: +5" "undecodable: +1" "devices: +2" "track points: +8")
+    if(NOT report MATCHES "${line}")
+        message(FATAL_ERROR "Expected \"${line}\" in the report")
+    endif()
+endforeach()
@@ -0,0 +1,168 @@
+/**
+ * Checks the software AES fallback against FIPS-197 and a LoRaWAN uplink,
+ * using the same vectors as the boot self-test, and prints how many
+ * cycles a frame takes: one block of payload encryption plus the MIC.
+ *
+ * The backends app.aes-backend selects between are mbedtls, which comes
+ * with mbed-os and isn't in this tree, and the STM32WL peripheral, so
+ * only the fallback is timed here. The others are only timed by the boot
+ * benchmark on target.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "aes_soft.h"
+#include "aes_vectors.h"
+#include "host_test.h"
+
+#define BENCH_FRAMES    20000
+
+static void xor_block(uint8_t *out, const uint8_t *a, const uint8_t *b, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        out[i] = a[i] ^ b[i];
+    }
+}
+
+static void double_block(uint8_t block[16]) {
+    uint8_t carry = block[0] & 0x80;
+    for (int i = 0; i < 15; i++) {
+        block[i] = (block[i] << 1) | (block[i + 1] >> 7);
+    }
+    block[15] = (block[15] << 1) ^ (carry ? 0x87 : 0);
+}
+
+/**
+ * RFC 4493 AES-CMAC, as mbedtls_cipher_cmac() does it on target
+ */
+static void cmac(const uint32_t *rk, const uint8_t *msg, size_t len, uint8_t tag[16]) {
+    uint8_t k1[16] = {}, k2[16];
+    uint8_t last[16] = {};
+    uint8_t x[16] = {};
+    size_t blocks = len ? (len + 15) / 16 : 1;
+    size_t tail = len - (blocks - 1) * 16;
+
+    aes_soft_encrypt(rk, 10, k1, k1);
+    double_block(k1);
+    memcpy(k2, k1, sizeof(k2));
+    double_block(k2);
+
+    memcpy(last, msg + (blocks - 1) * 16, tail);
+    if (tail == 16) {
+        xor_block(last, last, k1, 16);
+    } else {
+        last[tail] = 0x80;
+        xor_block(last, last, k2, 16);
+    }
+
+    for (size_t i = 0; i + 1 < blocks; i++) {
+        xor_block(x, x, msg + i * 16, 16);
+        aes_soft_encrypt(rk, 10, x, x);
+    }
+    xor_block(x, x, last, 16);
+    aes_soft_encrypt(rk, 10, x, tag);
+}
+
+/**
+ * MIC and decrypted FRMPayload of the LoRaWAN vector
+ */
+static void lorawan_frame_crypto(const uint32_t *nwk_rk, const uint32_t *app_rk,
+                                 uint8_t mic[4], uint8_t plain[4]) {
+    uint8_t msg[sizeof(lorawan_b0) + sizeof(lorawan_frame)];
+    uint8_t block[16];
+
+    memcpy(msg, lorawan_b0, sizeof(lorawan_b0));
+    memcpy(msg + sizeof(lorawan_b0), lorawan_frame, sizeof(lorawan_frame));
+    cmac(nwk_rk, msg, sizeof(msg), block);
+    memcpy(mic, block, 4);
+
+    aes_soft_encrypt(app_rk, 10, lorawan_a1, block);
+    xor_block(plain, lorawan_frame + LORAWAN_PAYLOAD_OFFSET, block, 4);
+}
+
+static uint64_t cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+int main(void) {
+    uint32_t rk[AES_SOFT_RK_WORDS];
+    uint32_t nwk_rk[AES_SOFT_RK_WORDS];
+    uint32_t app_rk[AES_SOFT_RK_WORDS];
+    uint8_t block[16];
+
+    // FIPS-197 C.1, round keys are little-endian words like mbedtls
+    aes_soft_expand_key(aes_key, rk);
+    CHECK(rk[0] == 0x03020100);
+    aes_soft_encrypt(rk, 10, aes_plain, block);
+    CHECK(memcmp(block, aes_cipher, sizeof(block)) == 0);
+
+    // FIPS-197 A.1 key expansion, w[43] = b6630ca6 read big-endian
+    static const uint8_t fips_a1_key[16] = {
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+    };
+    aes_soft_expand_key(fips_a1_key, rk);
+    CHECK(rk[43] == 0xa60c63b6);
+
+    // RFC 4493 examples 1 and 2 use the same key, so the test's CMAC is right too
+    static const uint8_t rfc4493_empty[16] = {
+        0xbb, 0x1d, 0x69, 0x29, 0xe9, 0x59, 0x37, 0x28,
+        0x7f, 0xa3, 0x7d, 0x12, 0x9b, 0x75, 0x67, 0x46
+    };
+    static const uint8_t rfc4493_message[16] = {
+        0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+        0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a
+    };
+    static const uint8_t rfc4493_tag[16] = {
+        0x07, 0x0a, 0x16, 0xb4, 0x6b, 0x4d, 0x41, 0x44,
+        0xf7, 0x9b, 0xdd, 0x9d, 0xd0, 0x4a, 0x28, 0x7c
+    };
+    cmac(rk, NULL, 0, block);
+    CHECK(memcmp(block, rfc4493_empty, sizeof(block)) == 0);
+    cmac(rk, rfc4493_message, sizeof(rfc4493_message), block);
+    CHECK(memcmp(block, rfc4493_tag, sizeof(block)) == 0);
+
+    // LoRaWAN uplink
+    uint8_t mic[4], plain[4];
+    aes_soft_expand_key(lorawan_nwk_skey, nwk_rk);
+    aes_soft_expand_key(lorawan_app_skey, app_rk);
+    lorawan_frame_crypto(nwk_rk, app_rk, mic, plain);
+    CHECK(memcmp(mic, lorawan_mic, sizeof(mic)) == 0);
+    CHECK(memcmp(plain, lorawan_plain, sizeof(plain)) == 0);
+
+    // A flipped bit in the frame has to change the MIC
+    uint8_t msg[sizeof(lorawan_b0) + sizeof(lorawan_frame)];
+    memcpy(msg, lorawan_b0, sizeof(lorawan_b0));
+    memcpy(msg + sizeof(lorawan_b0), lorawan_frame, sizeof(lorawan_frame));
+    msg[sizeof(msg) - 1] ^= 1;
+    cmac(nwk_rk, msg, sizeof(msg), block);
+    CHECK(memcmp(block, lorawan_mic, sizeof(lorawan_mic)) != 0);
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t start_cycles = cycles();
+    for (int i = 0; i < BENCH_FRAMES; i++) {
+        lorawan_frame_crypto(nwk_rk, app_rk, mic, plain);
+    }
+    uint64_t frame_cycles = (cycles() - start_cycles) / BENCH_FRAMES;
+    double frame_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+                      / BENCH_FRAMES;
+    CHECK(memcmp(mic, lorawan_mic, sizeof(mic)) == 0);
+
+    // 4 block encryptions per frame: CMAC subkeys, B0, the frame and A1
+    printf("software fallback: %.0f ns per frame", frame_ns);
+    if (frame_cycles) {
+        printf(", %llu cycles per frame, %llu per block", (unsigned long long)frame_cycles,
+               (unsigned long long)(frame_cycles / 4));
+    }
+    printf("\n");
+
+    return test_result();
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <math.h>
+
+/**
+ * MHDR, DevAddr, FCtrl, FCnt, FPort and MIC around the application payload
+ */
+#define LORAWAN_OVERHEAD    13
+
+/**
+ * LoRa time on air in ms for an uplink with len bytes of application
+ * payload, 125 kHz, CR 4/5, 8 symbol preamble, explicit header and CRC
+ */
+static inline double lora_airtime_ms(unsigned len, unsigned sf) {
+    double symbol = (double)(1 << sf) / 125.0;
+    int low_rate = sf >= 11;
+    double payload_symbols = ceil((8.0 * (len + LORAWAN_OVERHEAD) - 4 * sf + 28 + 16)
+                                  / (4.0 * (sf - 2 * low_rate))) * 5;
+    if (payload_symbols < 0)
+        payload_symbols = 0;
+    return (8 + 4.25) * symbol + (8 + payload_symbols) * symbol;
+}
@@ -0,0 +1,71 @@
+/**
+ * Builds the board dependent code for one board profile, picked with
+ * APP_BOARD as custom_targets.json does, against the mbed stubs. Checks
+ * the profile hangs together and that hardware it doesn't have is never
+ * touched. tests/CMakeLists.txt builds one probe per profile.
+ */
+#include <math.h>
+
+#include "board_profile.h"
+#include "gps.h"
+#include "BMP280.h"
+#include "sensors.h"
+#include "host_test.h"
+
+#define STRINGIFY(x)    #x
+#define BOARD_NAME(x)   STRINGIFY(x)
+
+TinyGPSPlus gps_parser;
+
+static int standby_calls = 0;
+static bool in_standby = false;
+
+void set_gps_standby(bool standby) {
+    standby_calls++;
+    in_standby = standby;
+}
+
+int main(void) {
+    printf("%s\n", BOARD_NAME(APP_BOARD));
+
+    // Every custom target is an STM32WL module
+    CHECK(Board::radio == RADIO_STM32WL);
+    CHECK(Board::gps_tx != NC && Board::gps_rx != NC);
+    CHECK(Board::gps_baud > 0);
+    CHECK(Board::battery_adc != NC);
+
+    // GPS power goes the profile's way and only that way
+    GpsPower<Board::gps_power_style> power(Board::gps_power);
+    power.write(1);
+    power.write(0);
+    if (Board::gps_power_style == GPS_POWER_SWITCH) {
+        CHECK(Board::gps_power != NC);
+        CHECK(stub_digital_out_writes == 2);
+        CHECK(standby_calls == 0);
+    } else {
+        CHECK(stub_digital_out_writes == 0);
+        CHECK(standby_calls == 2);
+        CHECK(in_standby);
+    }
+
+    // Pressure only from boards with the sensor, nothing else happens without it
+    telemetry_t t = {};
+    read_bmp280(t);
+    if (Board::has_bmp280) {
+        CHECK(Board::bmp280_sda != NC && Board::bmp280_scl != NC);
+        CHECK(stub_bmp280_instances == 1);
+        CHECK(t.pressure == 101325);
+        CHECK(t.temp == 150 + 128);
+    } else {
+        CHECK(stub_bmp280_instances == 0);
+        CHECK(t.pressure == 0);
+    }
+    CHECK(stub_deep_sleep_locks == 0);
+
+    // 3.6 V at the battery through the profile's divider
+    stub_adc_value = 3.6f / (Board::adc_reference * Board::battery_divider);
+    read_battery(t);
+    CHECK(abs(t.battery - (int)lroundf(1.6f * 255 / 2.3f)) <= 1);
+
+    return test_result();
+}
@@ -0,0 +1,61 @@
+#include "equeue_model.h"
+
+
+static struct equeue_event *event_of(void *e) {
+    return (struct equeue_event *)((unsigned char *)e - EQUEUE_EVENT_HEADER);
+}
+
+void equeue_model_init(struct equeue *q, void *buffer, size_t size) {
+    q->chunks = NULL;
+    q->slab.size = size;
+    q->slab.data = (unsigned char *)buffer;
+}
+
+/**
+ * First free chunk big enough, else a new one off the slab
+ */
+extern "C" void *equeue_alloc(struct equeue *q, size_t size) {
+    size = (EQUEUE_EVENT_HEADER + size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+    for (struct equeue_event **p = &q->chunks; *p; p = &(*p)->next) {
+        if ((*p)->size >= size) {
+            struct equeue_event *e = *p;
+            if (e->sibling) {
+                *p = e->sibling;
+                (*p)->next = e->next;
+            } else {
+                *p = e->next;
+            }
+            return (unsigned char *)e + EQUEUE_EVENT_HEADER;
+        }
+    }
+
+    if (q->slab.size >= size) {
+        struct equeue_event *e = (struct equeue_event *)q->slab.data;
+        q->slab.data += size;
+        q->slab.size -= size;
+        e->size = size;
+        return (unsigned char *)e + EQUEUE_EVENT_HEADER;
+    }
+    return NULL;
+}
+
+/**
+ * Back on the list for its size, sorted smallest first
+ */
+extern "C" void equeue_dealloc(struct equeue *q, void *p) {
+    struct equeue_event *e = event_of(p);
+    struct equeue_event **chunk = &q->chunks;
+
+    while (*chunk && (*chunk)->size < e->size) {
+        chunk = &(*chunk)->next;
+    }
+    if (*chunk && (*chunk)->size == e->size) {
+        e->sibling = *chunk;
+        e->next = (*chunk)->next;
+    } else {
+        e->sibling = NULL;
+        e->next = *chunk;
+    }
+    *chunk = e;
+}
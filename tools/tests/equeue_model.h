@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Stand-in for mbed's equeue allocator, which comes with mbed-os and isn't
+ * in this tree. The allocation strategy follows equeue_mem_alloc() and
+ * equeue_mem_dealloc(): events are carved off the slab and never merged,
+ * freed ones go on a list per size, so the buffer fragments like it does
+ * on target. Only the fields the profiler reads are kept.
+ */
+struct equeue_event {
+    unsigned size;                  // bytes, header included
+    struct equeue_event *next;      // next larger free size
+    struct equeue_event *sibling;   // next free chunk of this size
+};
+
+struct equeue {
+    struct equeue_event *chunks;
+    struct {
+        size_t size;
+        unsigned char *data;
+    } slab;
+};
+
+/**
+ * Size of struct equeue_event on a 32 bit target, the model's events are
+ * carved with the same overhead
+ */
+#define EQUEUE_EVENT_HEADER     36
+
+void equeue_model_init(struct equeue *q, void *buffer, size_t size);
+
+/**
+ * Defined in equeue_model.cpp, so calls from the test go through the
+ * -Wl,--wrap=equeue_alloc wrap the way the stack's calls do on target
+ */
+extern "C" void *equeue_alloc(struct equeue *q, size_t size);
+extern "C" void equeue_dealloc(struct equeue *q, void *e);
@@ -0,0 +1,268 @@
+/**
+ * Runs a synthetic workload through the event queue profiler's stats: the
+ * application's cycle events plus the LoRaWAN stack's posts around each
+ * uplink, on a queue the size of the firmware's (10 events).
+ *
+ * Events are allocated with equeue_alloc() through the firmware's
+ * -Wl,--wrap=equeue_alloc wrap, and occupancy comes from the firmware's
+ * walk of the queue's free lists. equeue itself comes with mbed-os, so the
+ * allocator underneath is the model in equeue_model.cpp.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "evq_stats.h"
+#include "equeue_model.h"
+#include "host_test.h"
+
+#define EVENT_SIZE          52      // EVENTS_EVENT_SIZE
+#define QUEUE_SIZE          (10 * EVENT_SIZE)
+
+#define SLOT_SKIP_CYCLE     0
+#define SLOT_LORA_EVENT     2
+#define SLOT_STACK          0xFF    // not profiled, the stack posts with call()
+
+#define MAX_PENDING         32
+
+/**
+ * What ProfiledEventQueue::allocated() does with each allocation
+ */
+static struct equeue *hooked_queue;
+static EvqStats *hooked_stats;
+static unsigned hook_calls;
+
+static size_t used(const struct equeue *q) {
+    size_t free_bytes = evq_free_bytes(q->slab.size, q->chunks);
+    return free_bytes > QUEUE_SIZE ? 0 : QUEUE_SIZE - free_bytes;
+}
+
+static void alloc_hook(struct equeue *q, void *e) {
+    hook_calls++;
+    if (q != hooked_queue) {
+        return;
+    }
+    if (!e) {
+        hooked_stats->post_failed();
+    }
+    hooked_stats->sample(used(q));
+}
+
+struct pending_t {
+    void *event;
+    uint8_t slot;
+    uint32_t posted;    // ms
+    uint32_t exec;      // ms of work
+    uint32_t idle;      // ms of sleeping or waiting for GPS
+};
+
+/**
+ * Dispatches in FIFO order on a simulated clock, timing callbacks the way
+ * ProfiledEventQueue::run() does
+ */
+class QueueModel {
+public:
+    explicit QueueModel(EvqStats &stats) : _stats(stats), _head(0), _count(0), _now(0), _dropped(0) {
+        equeue_model_init(&_queue, _buffer, sizeof(_buffer));
+        hooked_queue = &_queue;
+        hooked_stats = &stats;
+        evq_set_alloc_hook(alloc_hook);
+    }
+
+    ~QueueModel() {
+        evq_set_alloc_hook(NULL);
+    }
+
+    bool post(size_t payload, uint8_t slot, uint32_t exec, uint32_t idle = 0) {
+        void *e = equeue_alloc(&_queue, payload);
+        if (!e || _count == MAX_PENDING) {
+            _dropped++;
+            return false;
+        }
+        _pending[(_head + _count++) % MAX_PENDING] = {e, slot, _now, exec, idle};
+        return true;
+    }
+
+    /**
+     * Run everything pending, events posted meanwhile included
+     */
+    void dispatch(void) {
+        while (_count) {
+            pending_t e = _pending[_head];
+            _head = (_head + 1) % MAX_PENDING;
+            _count--;
+
+            uint32_t start = _now;
+            uint32_t idle = _stats.idle_ms();
+            _now += e.exec + e.idle;
+            _stats.idle(e.idle);
+            if (e.slot != SLOT_STACK) {
+                _stats.finished(e.slot, start - e.posted, _now - start, idle);
+            }
+            equeue_dealloc(&_queue, e.event);
+            _stats.sample(used(&_queue));
+        }
+    }
+
+    void advance(uint32_t ms) {
+        _now += ms;
+    }
+
+    unsigned dropped(void) const {
+        return _dropped;
+    }
+
+    struct equeue *queue(void) {
+        return &_queue;
+    }
+
+private:
+    EvqStats &_stats;
+    struct equeue _queue;
+    unsigned char _buffer[QUEUE_SIZE];
+    pending_t _pending[MAX_PENDING];
+    unsigned _head;
+    unsigned _count;
+    uint32_t _now;
+    unsigned _dropped;
+};
+
+/**
+ * One uplink cycle: skip_cycle reads the sensors, the stack sends, the
+ * radio raises TX done and the two receive windows, and the stack hands
+ * the result to the application, which sleeps until the next cycle and
+ * waits for a fix. burst extra radio events arrive before the dispatcher
+ * gets to run, as when the main thread is stuck in a long callback.
+ */
+static void cycle(QueueModel &queue, unsigned burst, uint32_t gps_ms) {
+    queue.post(8, SLOT_SKIP_CYCLE, 50, gps_ms);
+    queue.dispatch();
+
+    queue.post(12, SLOT_STACK, 2);      // TX done
+    for (unsigned i = 0; i < burst; i++) {
+        queue.post(12, SLOT_STACK, 1);  // radio IRQs behind it
+    }
+    queue.advance(1000);
+    queue.post(12, SLOT_STACK, 3);      // RX1 timeout
+    queue.advance(1000);
+    queue.post(12, SLOT_STACK, 3);      // RX2 timeout
+    queue.post(8, SLOT_LORA_EVENT, 5, 600000);  // TX_DONE, then standby()
+    queue.dispatch();
+}
+
+static unsigned hist_total(const uint16_t *hist) {
+    unsigned total = 0;
+    for (int b = 0; b < EVQ_HIST_BUCKETS; b++) {
+        total += hist[b];
+    }
+    return total;
+}
+
+int main(void) {
+    // A day of quiet cycles never gets near full
+    {
+        EvqStats stats(QUEUE_SIZE, EVENT_SIZE);
+        QueueModel queue(stats);
+        hook_calls = 0;
+        for (int i = 0; i < 144; i++) {
+            cycle(queue, 0, 20000 + (i % 7) * 10000);
+        }
+        stats.dump();
+
+        CHECK(hook_calls == 144 * 5);   // every allocation went through the wrap
+        CHECK(queue.dropped() == 0);
+        CHECK(stats.post_failures() == 0);
+        CHECK(stats.full_samples() == 0);
+        CHECK(stats.peak_percent() > 0 && stats.peak_percent() < 50);
+        CHECK(used(queue.queue()) == 0);
+
+        // The GPS wait and the sleep aren't execution time
+        const evq_slot_stats_t &skip = stats.slot(SLOT_SKIP_CYCLE);
+        CHECK(skip.count == 144);
+        CHECK(skip.max_exec == 50);
+        CHECK(hist_total(skip.exec_hist) == 144);
+        CHECK(hist_total(skip.wait_hist) == 144);
+        CHECK(skip.exec_hist[3] == 144);    // 16-63 ms
+
+        // The stack's events behind TX done make TX_DONE wait
+        const evq_slot_stats_t &lora = stats.slot(SLOT_LORA_EVENT);
+        CHECK(lora.count == 144);
+        CHECK(lora.max_exec == 5);
+        CHECK(lora.max_wait > 0);
+    }
+
+    // Bursts of radio events fill the queue, the stack's lost posts are
+    // counted by the wrap
+    {
+        EvqStats stats(QUEUE_SIZE, EVENT_SIZE);
+        QueueModel queue(stats);
+        for (int i = 0; i < 48; i++) {
+            cycle(queue, i % 4 == 3 ? 12 : 2, 30000);
+        }
+        stats.dump();
+
+        CHECK(queue.dropped() > 0);
+        CHECK(stats.post_failures() == queue.dropped());
+        CHECK(stats.full_samples() > 0);
+        CHECK(stats.peak_percent() > 90);
+        // The application's own events got through between the bursts
+        CHECK(stats.slot(SLOT_SKIP_CYCLE).count == 48);
+    }
+
+    // Freed events aren't merged: a bigger event fails on a queue that's
+    // empty by the byte count, which only the wrap sees
+    {
+        EvqStats stats(QUEUE_SIZE, EVENT_SIZE);
+        QueueModel queue(stats);
+        for (int i = 0; i < 10; i++) {
+            queue.post(12, SLOT_STACK, 1);
+        }
+        queue.dispatch();
+        CHECK(used(queue.queue()) == 0);
+        CHECK(stats.post_failures() == 0);
+
+        uint32_t full = stats.full_samples();
+        CHECK(!queue.post(40, SLOT_STACK, 1));
+        CHECK(stats.post_failures() == 1);
+        CHECK(stats.full_samples() == full);
+        CHECK(queue.post(12, SLOT_STACK, 1));
+        CHECK(used(queue.queue()) > 0);
+    }
+
+    // Bucket edges, the shared last slot and saturating buckets
+    {
+        EvqStats stats(QUEUE_SIZE, EVENT_SIZE);
+        static const uint32_t exec[] = {0, 1, 3, 4, 15, 16, 4095, 4096, 1000000};
+        static const uint8_t bucket[] = {0, 1, 1, 2, 2, 3, 6, 7, 7};
+        for (unsigned i = 0; i < sizeof(exec) / sizeof(exec[0]); i++) {
+            EvqStats one(QUEUE_SIZE, EVENT_SIZE);
+            one.finished(1, 0, exec[i], one.idle_ms());
+            CHECK(one.slot(1).exec_hist[bucket[i]] == 1);
+            CHECK(one.slot(1).wait_hist[0] == 1);
+        }
+
+        stats.finished(40, 0, 0, 0);
+        CHECK(stats.slot(EVQ_PROFILE_SLOTS - 1).count == 1);
+        CHECK(stats.slot(40).count == 1);
+
+        for (int i = 0; i < 70000; i++) {
+            stats.finished(3, 0, 0, 0);
+        }
+        CHECK(stats.slot(3).count == 70000);
+        CHECK(stats.slot(3).exec_hist[0] == 0xFFFF);
+
+        // Only idle time during the callback is taken off
+        stats.idle(1000);
+        uint32_t idle = stats.idle_ms();
+        stats.idle(30000);
+        stats.finished(4, 0, 30050, idle);
+        CHECK(stats.slot(4).max_exec == 50);
+
+        stats.sample(QUEUE_SIZE - EVENT_SIZE);
+        CHECK(stats.full_samples() == 0);
+        stats.sample(QUEUE_SIZE - EVENT_SIZE + 4);
+        CHECK(stats.full_samples() == 1);
+        CHECK(stats.peak_percent() == 90);
+    }
+
+    return test_result();
+}
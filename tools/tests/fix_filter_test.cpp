@@ -0,0 +1,317 @@
+/**
+ * Replays synthetic flights through FixFilter with the firmware's limits
+ * and injected receiver glitches, and counts the bad positions that would
+ * have gone out without the filter against those that still do.
+ *
+ * The flights follow the firmware's uplink cadence: a fix every 2 minutes
+ * climbing and descending and every 10 minutes at float, where the wind
+ * carries the balloon at up to 35 m/s. One flight crosses the antimeridian.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fix_filter.h"
+#include "host_test.h"
+
+#define EARTH_RADIUS    6371000.0
+
+/**
+ * A fix sent as good or degraded this far from the truth is a bad uplink
+ */
+#define BAD_DISTANCE    3000    // m
+#define BAD_ALTITUDE    1000    // m
+
+/**
+ * Estimates are flagged as such, but shouldn't be further off than this.
+ * Coasting through the top of the climb or a burst is the worst case.
+ */
+#define ESTIMATE_DISTANCE   5000    // m
+#define ESTIMATE_ALTITUDE   3000    // m
+
+enum glitch_t {
+    GLITCH_NONE = 0,
+    GLITCH_JUMP,        // position off by hundreds of km
+    GLITCH_FAR_JUMP,    // off by thousands of km
+    GLITCH_NULL_ISLAND,
+    GLITCH_STALE,       // last fix repeated long after it was decoded
+    GLITCH_HIGH_HDOP,
+    GLITCH_FEW_SATS,
+    GLITCH_NEGATIVE,    // altitude below sea level
+    GLITCH_TOO_HIGH,    // altitude above anything a balloon reaches
+    GLITCH_COUNT
+};
+
+static const char *const glitch_names[GLITCH_COUNT] = {
+    "none", "jump", "far jump", "null island", "stale", "high hdop", "few sats", "negative", "too high"
+};
+
+struct truth_t {
+    uint32_t time;      // s
+    double lat;         // deg
+    double lon;         // deg
+    double altitude;    // m
+};
+
+struct replay_stats_t {
+    unsigned fixes;
+    unsigned glitches[GLITCH_COUNT];
+    unsigned sent_bad[GLITCH_COUNT];    // bad positions that still went out as fixes
+    unsigned sent_bad_good;             // of those, flagged FIX_GOOD
+    unsigned good_dropped;              // good fixes that didn't go out
+    unsigned estimated;
+    double estimate_error;              // m, worst horizontal
+    double estimate_altitude_error;     // m, worst
+};
+
+static uint32_t rng_state;
+
+static uint32_t rng(void) {
+    rng_state = rng_state * 1103515245 + 12345;
+    return (rng_state >> 8) & 0xFFFFFF;
+}
+
+static double noise(double amplitude) {
+    return ((double)rng() / 0xFFFFFF * 2 - 1) * amplitude;
+}
+
+static double wrap(double lon) {
+    return lon > 180 ? lon - 360 : lon < -180 ? lon + 360 : lon;
+}
+
+static double distance_m(double lat1, double lon1, double lat2, double lon2) {
+    double dlat = (lat2 - lat1) * M_PI / 180;
+    double dlon = wrap(lon2 - lon1) * M_PI / 180 * cos((lat1 + lat2) / 2 * M_PI / 180);
+    return EARTH_RADIUS * sqrt(dlat * dlat + dlon * dlon);
+}
+
+/**
+ * Climb at 5 m/s to float, drift with a meandering wind, burst and fall
+ */
+static unsigned make_flight(double lat, double lon, double float_altitude, unsigned float_hours,
+                            truth_t *track, unsigned max) {
+    unsigned n = 0;
+    uint32_t time = 0;
+    double altitude = 0;
+    bool burst = false;
+    double fall = 0;
+
+    while (n < max) {
+        track[n++] = {time, lat, lon, altitude};
+
+        uint32_t dt;
+        double vz;
+        if (!burst && altitude < float_altitude) {
+            dt = 120;
+            vz = 5;
+        } else if (!burst && time < float_hours * 3600) {
+            dt = 600;
+            vz = 0;
+        } else {
+            // Thin air at burst, slowing down under the parachute
+            burst = true;
+            dt = 120;
+            fall = altitude > 8000 ? 40 : altitude > 3000 ? 15 : 6;
+            vz = -fall;
+        }
+        if (burst && altitude <= 0)
+            break;
+
+        double wind = altitude > 8000 ? 25 + 10 * sin(time / 7200.0) : 8;
+        double heading = 1.3 + 0.4 * sin(time / 10800.0);
+        double north = wind * cos(heading) * dt;
+        double east = wind * sin(heading) * dt;
+
+        lat += north / EARTH_RADIUS * 180 / M_PI;
+        lon = wrap(lon + east / (EARTH_RADIUS * cos(lat * M_PI / 180)) * 180 / M_PI);
+        altitude = fmax(0, fmin(float_altitude, altitude + vz * dt));
+        time += dt;
+    }
+    return n;
+}
+
+static gps_fix_t make_fix(const truth_t &truth, glitch_t glitch) {
+    gps_fix_t fix;
+
+    fix.lat = lround((truth.lat + noise(0.00005)) * 1e6);
+    fix.lon = lround(wrap(truth.lon + noise(0.00005)) * 1e6);
+    fix.altitude = lround(truth.altitude + noise(10));
+    fix.hdop = 90 + rng() % 60;
+    fix.sats = 7 + rng() % 5;
+    fix.age = 300 + rng() % 700;
+
+    switch (glitch) {
+        case GLITCH_JUMP:
+            fix.lat += (rng() & 1 ? 1 : -1) * (int32_t)(2000000 + rng() % 3000000);
+            break;
+        case GLITCH_FAR_JUMP:
+            fix.lon = lround(wrap(truth.lon + 40 + noise(20)) * 1e6);
+            break;
+        case GLITCH_NULL_ISLAND:
+            fix.lat = fix.lon = 0;
+            break;
+        case GLITCH_STALE:
+            fix.age = 30000 + rng() % 60000;
+            fix.lat -= 500000;     // where we were minutes ago
+            break;
+        case GLITCH_HIGH_HDOP:
+            fix.hdop = 800 + rng() % 2000;
+            fix.lat += 300000;
+            break;
+        case GLITCH_FEW_SATS:
+            fix.sats = rng() % 4;
+            fix.lon += 400000;
+            break;
+        case GLITCH_NEGATIVE:
+            fix.altitude = -1000 - (int32_t)(rng() % 5000);
+            break;
+        case GLITCH_TOO_HIGH:
+            fix.altitude = 50000 + rng() % 20000;
+            break;
+        default:
+            break;
+    }
+    return fix;
+}
+
+static void replay(const truth_t *track, unsigned n, unsigned glitch_every, unsigned first_glitch,
+                   replay_stats_t &stats) {
+    FixFilter filter(fix_filter_default_config);
+    unsigned next_glitch = 0;
+
+    for (unsigned i = 0; i < n; i++) {
+        glitch_t glitch = GLITCH_NONE;
+        if (i >= first_glitch && (i - first_glitch) % glitch_every == 0) {
+            glitch = (glitch_t)(1 + next_glitch++ % (GLITCH_COUNT - 1));
+        }
+
+        gps_fix_t fix = make_fix(track[i], glitch);
+        gps_fix_t estimate;
+        fix_quality_t quality = filter.update(fix, track[i].time, estimate);
+
+        stats.fixes++;
+        stats.glitches[glitch]++;
+        if (quality == FIX_ESTIMATED)
+            stats.estimated++;
+
+        if (quality == FIX_REJECTED) {
+            if (glitch == GLITCH_NONE)
+                stats.good_dropped++;
+            continue;
+        }
+
+        double off = distance_m(track[i].lat, track[i].lon, estimate.lat / 1e6, estimate.lon / 1e6);
+        double off_altitude = fabs(track[i].altitude - estimate.altitude);
+        if (quality == FIX_ESTIMATED) {
+            stats.estimate_error = fmax(stats.estimate_error, off);
+            stats.estimate_altitude_error = fmax(stats.estimate_altitude_error, off_altitude);
+        } else if (off > BAD_DISTANCE || off_altitude > BAD_ALTITUDE) {
+            stats.sent_bad[glitch]++;
+            if (quality == FIX_GOOD)
+                stats.sent_bad_good++;
+        }
+    }
+}
+
+/**
+ * Every glitch caught and every good fix sent, estimates close enough
+ */
+static void check_clean(const replay_stats_t &stats) {
+    for (int g = GLITCH_NONE; g < GLITCH_COUNT; g++) {
+        CHECK(stats.sent_bad[g] == 0);
+    }
+    CHECK(stats.good_dropped == 0);
+    CHECK(stats.estimate_error < ESTIMATE_DISTANCE);
+    CHECK(stats.estimate_altitude_error < ESTIMATE_ALTITUDE);
+}
+
+static void report(const char *name, const replay_stats_t &stats) {
+    unsigned glitches = stats.fixes - stats.glitches[GLITCH_NONE];
+    unsigned sent_bad = 0;
+    for (int g = GLITCH_NONE + 1; g < GLITCH_COUNT; g++) {
+        sent_bad += stats.sent_bad[g];
+    }
+
+    printf("%s: %u fixes, %u glitches, bad uplinks %u without the filter, %u with it, "
+           "%u good fixes dropped, %u estimated, up to %.0f m and %.0f m altitude off\n",
+           name, stats.fixes, glitches, glitches, sent_bad, stats.good_dropped, stats.estimated,
+           stats.estimate_error, stats.estimate_altitude_error);
+    for (int g = GLITCH_NONE + 1; g < GLITCH_COUNT; g++) {
+        if (stats.sent_bad[g])
+            printf("  %s: %u of %u sent\n", glitch_names[g], stats.sent_bad[g], stats.glitches[g]);
+    }
+}
+
+#define MAX_TRACK   600
+
+int main(void) {
+    static truth_t track[MAX_TRACK];
+
+    // Long float from the UK, a glitch every 5th fix
+    {
+        replay_stats_t stats = {};
+        rng_state = 1;
+        unsigned n = make_flight(51.5, -1.3, 12000, 40, track, MAX_TRACK);
+        replay(track, n, 5, 3, stats);
+        report("uk float", stats);
+        CHECK(stats.glitches[GLITCH_NONE] > 200);
+        check_clean(stats);
+    }
+
+    // Drifting east over the antimeridian, glitches every 3rd fix
+    {
+        replay_stats_t stats = {};
+        rng_state = 2;
+        unsigned n = make_flight(45.0, 170.0, 10000, 30, track, MAX_TRACK);
+        CHECK(track[n - 1].lon < 0);
+        replay(track, n, 3, 1, stats);
+        report("antimeridian", stats);
+        check_clean(stats);
+    }
+
+    // The very first fix is a jump, the track has to recover from it
+    {
+        replay_stats_t stats = {};
+        rng_state = 3;
+        unsigned n = make_flight(-33.9, 151.2, 11000, 10, track, MAX_TRACK);
+        replay(track, n, 1000, 0, stats);
+        report("bad first fix", stats);
+        CHECK(stats.glitches[GLITCH_JUMP] == 1);
+        // The jump itself went out, but only as degraded since nothing backed
+        // it up. The next good fixes were held back as outliers until the
+        // track restarted, and nothing was estimated from it.
+        CHECK(stats.sent_bad[GLITCH_JUMP] == 1);
+        CHECK(stats.sent_bad_good == 0);
+        CHECK(stats.sent_bad[GLITCH_NONE] == 0);
+        CHECK(stats.good_dropped == fix_filter_default_config.max_gate_rejects - 1u);
+        CHECK(stats.estimated == 0);
+    }
+
+    // A fix is only good once a second one agrees, which is what the boot
+    // region pick waits for
+    {
+        FixFilter filter(fix_filter_default_config);
+        gps_fix_t fix = {51500000, -1300000, 100, 120, 8, 500};
+        gps_fix_t estimate;
+        CHECK(filter.update(fix, 1000, estimate) == FIX_DEGRADED);
+        fix.lat += 100;
+        CHECK(filter.update(fix, 1020, estimate) == FIX_GOOD);
+
+        // A glitch first: the real fixes after it are outliers, then start
+        // a new track that again needs a second fix
+        filter.reset();
+        gps_fix_t glitch = fix;
+        glitch.lat += 5000000;
+        CHECK(filter.update(glitch, 2000, estimate) == FIX_DEGRADED);
+        fix_quality_t quality = FIX_REJECTED;
+        unsigned fixes = 0;
+        while (quality != FIX_GOOD && fixes < 10) {
+            quality = filter.update(fix, 2020 + 20 * fixes++, estimate);
+            CHECK(quality != FIX_GOOD || estimate.lat == fix.lat);
+        }
+        CHECK(quality == FIX_GOOD);
+        CHECK(fixes == fix_filter_default_config.max_gate_rejects + 1u);
+    }
+
+    return test_result();
+}
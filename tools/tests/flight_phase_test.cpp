@@ -0,0 +1,332 @@
+/**
+ * Replays synthetic flights through FixFilter and FlightPhase the way the
+ * firmware runs them: the uplink interval and GPS window come from the
+ * phase policies, and each cycle feeds the filtered fix and a noisy
+ * pressure reading to the detector. Checks that every phase is found in
+ * order without false changes, how far a burst at float falls before
+ * DESCENT is taken, and prints the uplinks and energy spent in each phase.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "fix_filter.h"
+#include "flight_phase.h"
+#include "host_test.h"
+
+/**
+ * Current draw of the LoRa-E5 tracker. The GPS is switched off between
+ * fixes, so sleep is just the module.
+ */
+#define GPS_MA          28.0    // GPS tracking plus the MCU waiting on it
+#define TX_MA           45.0    // +14 dBm
+#define SLEEP_MA        0.005
+#define TX_AIRTIME_S    1.483   // SF12/125 kHz, 24 byte PHY payload
+
+/**
+ * gps_loop() stops once it has seen 10 sentences with a fix
+ */
+#define GPS_FIX_SENTENCES   11  // s at 1 Hz
+
+#define GROUND_ALTITUDE     100     // m
+#define CLIMB_RATE          5.0     // m/s
+#define LEAK_RATE           1.0     // m/s
+
+struct flight_t {
+    double float_altitude;  // m
+    uint32_t launch;        // s
+    uint32_t top;           // s, reached float
+    uint32_t burst;         // s, starts to come down
+    bool leak;              // slow leak instead of a burst
+    double burst_altitude;  // m
+    uint32_t landing;       // s
+};
+
+struct phase_report_t {
+    double seconds;
+    unsigned uplinks;
+    double gps_s;
+    double tx_s;
+    double mah;
+};
+
+struct transition_t {
+    uint32_t time;
+    double altitude;        // m, truth
+    flight_phase_t from;
+    flight_phase_t to;
+};
+
+#define MAX_TRANSITIONS     16
+
+struct replay_t {
+    phase_report_t phases[PHASE_COUNT];
+    transition_t transitions[MAX_TRANSITIONS];
+    unsigned transition_count;
+    unsigned samples_after_burst;   // before DESCENT was taken
+    unsigned fixes_missed;
+};
+
+static uint32_t rng_state;
+
+static uint32_t rng(void) {
+    rng_state = rng_state * 1103515245 + 12345;
+    return (rng_state >> 8) & 0xFFFFFF;
+}
+
+static double noise(double amplitude) {
+    return ((double)rng() / 0xFFFFFF * 2 - 1) * amplitude;
+}
+
+/**
+ * Gravity waves of a few tens of metres and the day/night swing at float
+ */
+static double float_wave(uint32_t t) {
+    return 40 * sin(2 * M_PI * t / 1500.0) + 150 * sin(2 * M_PI * t / 86400.0);
+}
+
+/**
+ * Thin air at burst, slowing down as it falls
+ */
+static double fall_rate(double altitude) {
+    return altitude > 8000 ? 40 : altitude > 3000 ? 15 : 6;
+}
+
+static double altitude_at(const flight_t &f, uint32_t t) {
+    if (t < f.launch || t >= f.landing)
+        return GROUND_ALTITUDE;
+    if (t < f.top)
+        return GROUND_ALTITUDE + CLIMB_RATE * (t - f.launch);
+    if (t < f.burst)
+        return f.float_altitude + float_wave(t) - float_wave(f.top);
+
+    double altitude = f.burst_altitude;
+    for (uint32_t s = f.burst; s < t && altitude > GROUND_ALTITUDE; s++) {
+        altitude -= f.leak ? LEAK_RATE : fall_rate(altitude);
+    }
+    return fmax(altitude, GROUND_ALTITUDE);
+}
+
+static flight_t make_flight(double float_altitude, uint32_t launch, uint32_t float_s, bool leak) {
+    flight_t f;
+    f.float_altitude = float_altitude;
+    f.launch = launch;
+    f.top = launch + (uint32_t)((float_altitude - GROUND_ALTITUDE) / CLIMB_RATE);
+    f.burst = f.top + float_s;
+    f.leak = leak;
+    f.landing = UINT32_MAX;
+    f.burst_altitude = altitude_at(f, f.burst - 1);
+
+    uint32_t t = f.burst;
+    while (altitude_at(f, t) > GROUND_ALTITUDE) {
+        t += 10;
+    }
+    f.landing = t;
+    return f;
+}
+
+/**
+ * US standard atmosphere, not the single scale height the detector assumes
+ */
+static double pressure_at(double altitude) {
+    if (altitude < 11000)
+        return 101325 * pow(1 - 2.25577e-5 * altitude, 5.25588);
+    return 22632 * exp(-(altitude - 11000) / 6341.6);
+}
+
+static gps_fix_t make_fix(const flight_t &f, uint32_t t) {
+    gps_fix_t fix;
+    // Drifting east at about 14 m/s while airborne
+    uint32_t airborne = t < f.launch ? 0 : (t < f.landing ? t : f.landing) - f.launch;
+
+    fix.lat = lround((51.5 + noise(0.00005)) * 1e6);
+    fix.lon = lround((-1.3 + airborne * 0.0002 + noise(0.00005)) * 1e6);
+    fix.altitude = lround(altitude_at(f, t) + noise(8));
+    fix.hdop = 90 + rng() % 60;
+    fix.sats = 7 + rng() % 5;
+    fix.age = 300 + rng() % 700;
+    return fix;
+}
+
+static const transition_t *find(const replay_t &r, flight_phase_t to) {
+    for (unsigned i = 0; i < r.transition_count; i++) {
+        if (r.transitions[i].to == to)
+            return &r.transitions[i];
+    }
+    return NULL;
+}
+
+/**
+ * Runs the flight from the ground until an hour after landing. With
+ * flat set, every phase uses that policy instead, as the firmware did
+ * with a fixed TX_TIMER.
+ */
+static void replay(const flight_t &f, const phase_policy_t *flat, replay_t &r) {
+    FixFilter filter(fix_filter_default_config);
+    FlightPhase phase(flight_phase_default_config);
+    uint32_t t = 1000;
+
+    memset(&r, 0, sizeof(r));
+    while (t < f.landing + 3600) {
+        flight_phase_t at_start = phase.phase();
+        const phase_policy_t &policy = flat ? *flat : phase_policies[at_start];
+
+        // A hot start, the loop gives up at the window
+        uint32_t acquire = 5 + rng() % 12;
+        bool fixed = acquire < policy.gps_window;
+        uint32_t gps_s = fixed ? acquire + GPS_FIX_SENTENCES : policy.gps_window;
+        if (gps_s > policy.gps_window)
+            gps_s = policy.gps_window;
+        t += gps_s;
+
+        flight_sample_t sample = {};
+        sample.time = t;
+        sample.pressure = lround(pressure_at(altitude_at(f, t)) + noise(3));
+        if (fixed) {
+            gps_fix_t estimate;
+            fix_quality_t quality = filter.update(make_fix(f, t), t, estimate);
+            sample.has_altitude = quality != FIX_REJECTED && quality != FIX_ESTIMATED;
+            sample.altitude = estimate.altitude;
+            sample.has_vertical_speed = sample.has_altitude && filter.has_vertical_speed();
+            sample.vertical_speed = filter.vertical_speed();
+        } else {
+            r.fixes_missed++;
+        }
+
+        phase.update(sample);
+        if (phase.phase() != at_start && r.transition_count < MAX_TRANSITIONS) {
+            r.transitions[r.transition_count++] = {t, altitude_at(f, t), at_start, phase.phase()};
+        }
+        if (t >= f.burst && !find(r, PHASE_DESCENT)) {
+            r.samples_after_burst++;
+        }
+
+        uint32_t interval = flat ? flat->tx_interval : flight_tx_interval(phase);
+        double cycle_s = gps_s + TX_AIRTIME_S + interval;
+        phase_report_t &p = r.phases[at_start];
+        p.seconds += cycle_s;
+        p.uplinks++;
+        p.gps_s += gps_s;
+        p.tx_s += TX_AIRTIME_S;
+        p.mah += (gps_s * GPS_MA + TX_AIRTIME_S * TX_MA + interval * SLEEP_MA) / 3600;
+
+        t += (uint32_t)lround(TX_AIRTIME_S) + interval;
+    }
+}
+
+static double total_mah(const replay_t &r) {
+    double mah = 0;
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        mah += r.phases[p].mah;
+    }
+    return mah;
+}
+
+static void report(const char *name, const flight_t &f, const replay_t &r, const replay_t &flat) {
+    printf("%s: float at %.0f m for %.1f h, %u fixes missed\n", name, f.float_altitude,
+           (f.burst - f.top) / 3600.0, r.fixes_missed);
+    for (unsigned i = 0; i < r.transition_count; i++) {
+        const transition_t &tr = r.transitions[i];
+        printf("  %7.2f h %-7s -> %-7s at %5.0f m\n", ((double)tr.time - f.launch) / 3600.0,
+               flight_phase_name(tr.from), flight_phase_name(tr.to), tr.altitude);
+    }
+    printf("  %-8s %8s %8s %8s %8s %8s\n", "phase", "hours", "uplinks", "gps s", "tx s", "mAh");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        const phase_report_t &s = r.phases[p];
+        printf("  %-8s %8.2f %8u %8.0f %8.0f %8.1f\n", flight_phase_name((flight_phase_t)p),
+               s.seconds / 3600, s.uplinks, s.gps_s, s.tx_s, s.mah);
+    }
+    printf("  total %.1f mAh, %.1f mAh with a flat 120 s interval\n", total_mah(r), total_mah(flat));
+}
+
+static const flight_phase_t expected[] = {
+    PHASE_LAUNCH, PHASE_ASCENT, PHASE_FLOAT, PHASE_DESCENT, PHASE_GROUND
+};
+
+static void check_phases(const flight_t &f, const replay_t &r) {
+    CHECK(r.transition_count == sizeof(expected) / sizeof(expected[0]));
+    for (unsigned i = 0; i < r.transition_count && i < sizeof(expected) / sizeof(expected[0]); i++) {
+        CHECK(r.transitions[i].to == expected[i]);
+    }
+
+    const transition_t *launch = find(r, PHASE_LAUNCH);
+    const transition_t *floating = find(r, PHASE_FLOAT);
+    const transition_t *landed = find(r, PHASE_GROUND);
+    CHECK(launch && launch->time - f.launch < 300);
+    // Leaving the climb and landing wait for the track's vertical speed to settle
+    CHECK(floating && floating->time > f.top && floating->time - f.top < 900);
+    CHECK(landed && landed->time > f.landing && landed->time - f.landing < 600);
+}
+
+int main(void) {
+    static const phase_policy_t flat_policy = {120, 30, false};
+
+    // Bursts at float, landing at different points in the 10 minute cycle
+    double worst_burst_drop = 0;
+    uint32_t worst_burst_time = 0;
+    for (int i = 0; i < 6; i++) {
+        replay_t r, flat;
+        rng_state = 10 + i;
+        flight_t f = make_flight(12400, 3600, 36 * 3600 + i * 97, false);
+        replay(f, NULL, r);
+        if (i == 0) {
+            rng_state = 10;
+            replay(f, &flat_policy, flat);
+            report("burst at float", f, r, flat);
+        }
+        check_phases(f, r);
+
+        // One sinking sample is enough to leave float
+        const transition_t *descent = find(r, PHASE_DESCENT);
+        CHECK(descent && descent->time > f.burst);
+        CHECK(r.samples_after_burst == 0);
+        if (descent) {
+            worst_burst_drop = fmax(worst_burst_drop, f.burst_altitude - descent->altitude);
+            worst_burst_time = descent->time - f.burst > worst_burst_time ? descent->time - f.burst : worst_burst_time;
+        }
+    }
+    // At float the first sample can come a whole interval after the burst
+    CHECK(worst_burst_time <= (uint32_t)phase_policies[PHASE_FLOAT].tx_interval + phase_policies[PHASE_FLOAT].gps_window + 2);
+    printf("burst: descent taken on the first sample after it, up to %u s and %.0f m down\n",
+           (unsigned)worst_burst_time, worst_burst_drop);
+
+    // A slow leak is below fast_sink, so it's confirmed on a shortened interval
+    {
+        replay_t r, flat;
+        rng_state = 20;
+        flight_t f = make_flight(11000, 3600, 20 * 3600 + 300, true);
+        replay(f, NULL, r);
+        rng_state = 20;
+        replay(f, &flat_policy, flat);
+        report("slow leak", f, r, flat);
+        check_phases(f, r);
+
+        const transition_t *descent = find(r, PHASE_DESCENT);
+        // The first sample after the leak starts only sees part of it, the
+        // next one starts the candidate and a descent interval later it's taken
+        CHECK(r.samples_after_burst <= 3);
+        CHECK(descent && descent->time - f.burst < 2 * 660 + 120);
+        if (descent) {
+            printf("slow leak: descent taken %u s and %.0f m down\n", (unsigned)(descent->time - f.burst),
+                   f.burst_altitude - descent->altitude);
+        }
+    }
+
+    // A reset at float comes back up as float, not a launch
+    {
+        FlightPhase phase(flight_phase_default_config);
+        flight_sample_t sample = {};
+        sample.time = 100000;
+        sample.pressure = lround(pressure_at(12400));
+        sample.has_altitude = true;
+        sample.altitude = 12400;
+        CHECK(phase.update(sample) == PHASE_FLOAT);
+        sample.time += 600;
+        sample.pressure += 2;
+        CHECK(phase.update(sample) == PHASE_FLOAT);
+        CHECK(!phase.pending());
+        CHECK(flight_tx_interval(phase) == phase_policies[PHASE_FLOAT].tx_interval);
+    }
+
+    return test_result();
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdio.h>
+
+/**
+ * Minimal checks for the host tests, main() returns test_result()
+ */
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+static inline int test_result(void) {
+    if (test_failures)
+        printf("%d check(s) failed\n", test_failures);
+    else
+        printf("all checks passed\n");
+    return test_failures ? 1 : 0;
+}
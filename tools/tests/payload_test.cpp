@@ -0,0 +1,207 @@
+/**
+ * Encodes a synthetic flight, drops frames at random and checks that the
+ * decoder agrees with a lossless reference whenever it isn't stale.
+ * Reports mean bytes and SF12 airtime against keyframe-only uplinks.
+ */
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "payload.h"
+#include "airtime.h"
+#include "host_test.h"
+
+#define FRAMES      2000
+
+static const payload_precision_t precision = {5, 10, 2, 2, 8000};
+
+static telemetry_t flight_sample(unsigned frame) {
+    telemetry_t t = {};
+    double minutes = frame;
+    // Climb to 12 km, then float with a slow drift in altitude
+    double altitude = frame < 200 ? frame * 60.0 : 12000 + 150 * sin(frame / 50.0);
+
+    t.has_fix = (frame % 97) != 13;     // lose the fix now and then
+    t.lat = payload_pack_lat(51.0 + minutes * 0.0004);
+    t.lon = payload_pack_lon(-1.0 + minutes * 0.003);
+    t.altitude = altitude;
+    t.speed = frame < 200 ? frame / 4 : 60 + frame % 3;
+    t.sats = 7 + (frame / 40) % 4;
+    t.quality = 3;
+    t.battery = 200 - frame / 40;
+    t.pressure = 101325 * exp(-altitude / 7400.0);
+    t.temp = 128 + 200 - (frame < 200 ? frame * 3 : 600) + frame % 5;
+    if (frame % 10 == 0) {
+        t.has_mem_stats = true;
+        t.stack_max = 2400;
+        t.heap_max = 9000;
+    }
+    return t;
+}
+
+static bool same_fields(const telemetry_t &a, const telemetry_t &b) {
+    if (a.has_fix != b.has_fix || a.battery != b.battery || a.pressure != b.pressure || a.temp != b.temp)
+        return false;
+    if (!a.has_fix)
+        return true;
+    return a.lat == b.lat && a.lon == b.lon && a.altitude == b.altitude && a.speed == b.speed
+           && a.sats == b.sats && a.quality == b.quality;
+}
+
+/**
+ * The reference decoder should be within quantisation of what was sent
+ */
+static bool close_to_input(const telemetry_t &in, const telemetry_t &out) {
+    if (in.has_fix != out.has_fix)
+        return false;
+    if (abs((int)in.pressure - (int)out.pressure) > precision.pressure_step / 2
+            || abs((int)in.temp - (int)out.temp) > precision.temp_step / 2
+            || abs((int)in.battery - (int)out.battery) > precision.battery_step / 2)
+        return false;
+    if (!in.has_fix)
+        return true;
+    // Coarse positions drop the bottom 8 bits
+    uint32_t position_error = in.altitude >= precision.coarse_position_above ? 0x80 : 0;
+    return (uint32_t)abs((int)in.lat - (int)out.lat) <= position_error
+           && (uint32_t)abs((int)in.lon - (int)out.lon) <= position_error
+           && abs((int)in.altitude - (int)out.altitude) <= precision.altitude_step / 2
+           && in.sats == out.sats && in.quality == out.quality;
+}
+
+static void run(double loss) {
+    PayloadEncoder encoder(10, precision);
+    PayloadDecoder reference;
+    PayloadDecoder lossy;
+    unsigned long bytes = 0;
+    unsigned long legacy_bytes = 0;
+    double airtime = 0;
+    double legacy_airtime = 0;
+    unsigned received = 0;
+    unsigned stale = 0;
+    unsigned mismatches = 0;
+
+    srand(1);
+    for (unsigned frame = 0; frame < FRAMES; frame++) {
+        telemetry_t in = flight_sample(frame);
+        uint8_t buf[PAYLOAD_MAX_LEN];
+        uint8_t port;
+        uint8_t len = encoder.encode(in, buf, sizeof(buf), port);
+        CHECK(len > 0 && len <= PAYLOAD_MAX_LEN);
+        encoder.commit();
+
+        unsigned legacy_len = in.has_fix ? GPS_PAYLOAD_LEN : STATUS_PAYLOAD_LEN;
+        bytes += len;
+        legacy_bytes += legacy_len;
+        airtime += lora_airtime_ms(len, 12);
+        legacy_airtime += lora_airtime_ms(legacy_len, 12);
+
+        telemetry_t ref;
+        CHECK(reference.decode(port, buf, len, frame, ref));
+        CHECK(!reference.is_stale());
+        CHECK(close_to_input(in, ref));
+
+        if (rand() < loss * RAND_MAX)
+            continue;
+
+        telemetry_t out;
+        if (!lossy.decode(port, buf, len, frame, out))
+            continue;   // a delta before the first keyframe
+        received++;
+        if (lossy.is_stale()) {
+            stale++;
+            continue;
+        }
+        if (!same_fields(ref, out))
+            mismatches++;
+    }
+
+    CHECK(mismatches == 0);
+    CHECK(bytes < legacy_bytes);
+    printf("loss %3.0f%%: %u received, %u stale, %u mismatches, mean %.2f bytes (keyframes only %.2f), "
+           "mean SF12 airtime %.0f ms (keyframes only %.0f ms)\n",
+           loss * 100, received, stale, mismatches, (double)bytes / FRAMES, (double)legacy_bytes / FRAMES,
+           airtime / FRAMES, legacy_airtime / FRAMES);
+}
+
+/**
+ * A send the stack refused mustn't change what the encoder thinks the ground has
+ */
+static void uncommitted_send(void) {
+    PayloadEncoder encoder(10, precision);
+    PayloadDecoder decoder;
+    uint8_t buf[PAYLOAD_MAX_LEN];
+    uint8_t port;
+    uint8_t len;
+    telemetry_t out;
+
+    telemetry_t first = flight_sample(300);
+    len = encoder.encode(first, buf, sizeof(buf), port);
+    encoder.commit();
+    CHECK(decoder.decode(port, buf, len, 0, out));
+
+    // Not committed, so the next delta has to carry this change again
+    telemetry_t second = flight_sample(301);
+    encoder.encode(second, buf, sizeof(buf), port);
+
+    len = encoder.encode(second, buf, sizeof(buf), port);
+    encoder.commit();
+    CHECK(port == DELTA_PORT);
+    CHECK(decoder.decode(port, buf, len, 1, out));
+    CHECK(!decoder.is_stale());
+    CHECK(close_to_input(second, out));
+}
+
+/**
+ * A frame the stack accepted but never transmitted (TX_TIMEOUT, TX_ERROR)
+ * doesn't advance the frame counter, so the ground sees no gap. The next
+ * delta has to be against the last frame that went out.
+ */
+static void lost_frame(bool commit_on_accept) {
+    PayloadEncoder encoder(10, precision);
+    PayloadDecoder decoder;
+    uint8_t buf[PAYLOAD_MAX_LEN];
+    uint8_t port;
+    uint8_t len;
+    telemetry_t out;
+
+    telemetry_t first = flight_sample(300);
+    len = encoder.encode(first, buf, sizeof(buf), port);
+    encoder.commit();
+    CHECK(decoder.decode(port, buf, len, 0, out));
+    uint8_t first_battery = out.battery;
+
+    // Battery sag carried by the lost frame only
+    telemetry_t second = first;
+    second.battery -= 10;
+    encoder.encode(second, buf, sizeof(buf), port);
+    if (commit_on_accept) {
+        encoder.commit();
+    } else {
+        encoder.discard();
+        encoder.commit();   // a stray TX_DONE mustn't resurrect it
+    }
+
+    telemetry_t third = second;
+    len = encoder.encode(third, buf, sizeof(buf), port);
+    encoder.commit();
+    CHECK(port == DELTA_PORT);
+    CHECK(decoder.decode(port, buf, len, 1, out));
+    CHECK(!decoder.is_stale());
+    if (commit_on_accept) {
+        // Committed too early the ground silently keeps the old reading
+        CHECK(out.battery == first_battery);
+    } else {
+        CHECK(abs((int)out.battery - (int)third.battery) <= precision.battery_step / 2);
+        CHECK(close_to_input(third, out));
+    }
+}
+
+int main(void) {
+    run(0.0);
+    run(0.1);
+    run(0.3);
+    uncommitted_send();
+    lost_frame(true);
+    lost_frame(false);
+    return test_result();
+}
@@ -0,0 +1,16 @@
+# Prints the size of each board profile's sensors.cpp object, under a
+# heading that says what the figures are: host code, only good for
+# comparing profiles with each other.
+#   cmake -DSIZE_TOOL=... -DOBJECTS=a.o;b.o -P profile_sizes.cmake
+
+message("Host-only sizes of sensors.cpp per board profile, relative figures for")
+message("comparing profiles, not flash usage. For the target's flash, build the")
+message("footprint target with GCC_ARM.")
+
+execute_process(
+    COMMAND ${SIZE_TOOL} ${OBJECTS}
+    RESULT_VARIABLE result
+)
+if(result)
+    message(FATAL_ERROR "${SIZE_TOOL} failed: ${result}")
+endif()
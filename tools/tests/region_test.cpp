@@ -0,0 +1,240 @@
+/**
+ * Looks up known places through the same packed coordinates the firmware
+ * uses, with towns either side of the no-go borders, and checks every plan
+ * can carry a full payload at its datarate.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "region.h"
+#include "payload.h"
+#include "host_test.h"
+
+/**
+ * REGION_UNKNOWN as the expected region means anything but REGION_NO_GO,
+ * for places where any plan is fine as long as we transmit
+ */
+struct place_t {
+    const char *name;
+    double lat;
+    double lon;
+    lora_region_t region;
+};
+
+static const place_t places[] = {
+    // Russia
+    {"Moscow", 55.76, 37.62, REGION_NO_GO},
+    {"St Petersburg", 59.94, 30.31, REGION_NO_GO},
+    {"Murmansk", 68.97, 33.08, REGION_NO_GO},
+    {"Nikel", 69.41, 30.22, REGION_NO_GO},
+    {"Svetogorsk", 61.11, 28.86, REGION_NO_GO},
+    {"Vyborg", 60.71, 28.75, REGION_NO_GO},
+    {"Ivangorod", 59.37, 28.22, REGION_NO_GO},
+    {"Pskov", 57.82, 28.33, REGION_NO_GO},
+    {"Velikiye Luki", 56.34, 30.53, REGION_NO_GO},
+    {"Smolensk", 54.78, 32.05, REGION_NO_GO},
+    {"Rudnya", 54.95, 31.09, REGION_NO_GO},
+    {"Novozybkov", 52.54, 31.93, REGION_NO_GO},
+    {"Bryansk", 53.25, 34.37, REGION_NO_GO},
+    {"Belgorod", 50.60, 36.60, REGION_NO_GO},
+    {"Rostov-on-Don", 47.23, 39.72, REGION_NO_GO},
+    {"Novorossiysk", 44.72, 37.77, REGION_NO_GO},
+    {"Sochi", 43.60, 39.73, REGION_NO_GO},
+    {"Vladikavkaz", 43.02, 44.68, REGION_NO_GO},
+    {"Makhachkala", 42.98, 47.50, REGION_NO_GO},
+    {"Astrakhan", 46.35, 48.04, REGION_NO_GO},
+    {"Volgograd", 48.71, 44.51, REGION_NO_GO},
+    {"Orenburg", 51.77, 55.10, REGION_NO_GO},
+    {"Orsk", 51.20, 58.57, REGION_NO_GO},
+    {"Omsk", 54.99, 73.37, REGION_NO_GO},
+    {"Rubtsovsk", 51.50, 81.20, REGION_NO_GO},
+    {"Norilsk", 69.35, 88.20, REGION_NO_GO},
+    {"Kyzyl", 51.72, 94.45, REGION_NO_GO},
+    {"Irkutsk", 52.29, 104.30, REGION_NO_GO},
+    {"Chita", 52.03, 113.50, REGION_NO_GO},
+    {"Khabarovsk", 48.48, 135.07, REGION_NO_GO},
+    {"Pogranichny", 44.40, 131.37, REGION_NO_GO},
+    {"Kraskino", 42.71, 130.80, REGION_NO_GO},
+    {"Vladivostok", 43.12, 131.89, REGION_NO_GO},
+    {"Nakhodka", 42.82, 132.89, REGION_NO_GO},
+    {"Yuzhno-Sakhalinsk", 46.96, 142.73, REGION_NO_GO},
+    {"Petropavlovsk-Kamchatsky", 53.02, 158.65, REGION_NO_GO},
+    {"Anadyr", 64.73, 177.50, REGION_NO_GO},
+    {"Uelen", 66.16, -169.81, REGION_NO_GO},
+    {"Provideniya", 64.42, -173.24, REGION_NO_GO},
+    {"Kaliningrad", 54.71, 20.51, REGION_NO_GO},
+    {"Sovetsk", 55.08, 21.87, REGION_NO_GO},
+
+    // China
+    {"Beijing", 39.90, 116.40, REGION_NO_GO},
+    {"Shanghai", 31.23, 121.47, REGION_NO_GO},
+    {"Shenzhen", 22.54, 114.06, REGION_NO_GO},
+    {"Harbin", 45.80, 126.53, REGION_NO_GO},
+    {"Mohe", 52.97, 122.54, REGION_NO_GO},
+    {"Suifenhe", 44.40, 131.15, REGION_NO_GO},
+    {"Hunchun", 42.87, 130.36, REGION_NO_GO},
+    {"Hulunbuir", 49.21, 119.77, REGION_NO_GO},
+    {"Urumqi", 43.83, 87.62, REGION_NO_GO},
+    {"Kashgar", 39.47, 75.99, REGION_NO_GO},
+    {"Lhasa", 29.65, 91.10, REGION_NO_GO},
+    {"Kunming", 25.04, 102.71, REGION_NO_GO},
+
+    // Central Asia, Mongolia and Iran east of 60E
+    {"Tashkent", 41.30, 69.24, REGION_NO_GO},
+    {"Dushanbe", 38.56, 68.78, REGION_NO_GO},
+    {"Mary", 37.60, 61.83, REGION_NO_GO},
+    {"Zahedan", 29.50, 60.86, REGION_NO_GO},
+    {"Chabahar", 25.29, 60.64, REGION_NO_GO},
+    {"Dalanzadgad", 43.57, 104.43, REGION_NO_GO},
+
+    // North Korea
+    {"Pyongyang", 39.02, 125.75, REGION_NO_GO},
+    {"Wonsan", 39.15, 127.44, REGION_NO_GO},
+    {"Haeju", 38.04, 125.71, REGION_NO_GO},
+    {"Kaesong", 37.97, 126.55, REGION_NO_GO},
+    {"Kosong", 38.73, 128.18, REGION_NO_GO},
+
+    // Pakistan
+    {"Lahore", 31.55, 74.34, REGION_NO_GO},
+    {"Kasur", 31.12, 74.45, REGION_NO_GO},
+    {"Sialkot", 32.49, 74.53, REGION_NO_GO},
+    {"Islamabad", 33.68, 73.05, REGION_NO_GO},
+    {"Peshawar", 34.01, 71.57, REGION_NO_GO},
+    {"Multan", 30.16, 71.52, REGION_NO_GO},
+    {"Rahim Yar Khan", 28.42, 70.30, REGION_NO_GO},
+    {"Quetta", 30.18, 67.00, REGION_NO_GO},
+    {"Karachi", 24.86, 67.00, REGION_NO_GO},
+    {"Gwadar", 25.12, 62.33, REGION_NO_GO},
+
+    // Next to Russia
+    {"Joensuu", 62.60, 29.76, REGION_EU868},
+    {"Imatra", 61.17, 28.77, REGION_EU868},
+    {"Lappeenranta", 61.06, 28.19, REGION_EU868},
+    {"Kuusamo", 65.97, 29.18, REGION_EU868},
+    {"Ivalo", 68.66, 27.54, REGION_EU868},
+    {"Kirkenes", 69.73, 30.05, REGION_EU868},
+    {"Helsinki", 60.17, 24.94, REGION_EU868},
+    {"Narva", 59.38, 28.19, REGION_EU868},
+    {"Tartu", 58.38, 26.72, REGION_EU868},
+    {"Ludza", 56.55, 27.72, REGION_EU868},
+    {"Daugavpils", 55.87, 26.54, REGION_EU868},
+    {"Klaipeda", 55.71, 21.13, REGION_EU868},
+    {"Gdansk", 54.35, 18.65, REGION_EU868},
+    {"Vitebsk", 55.19, 30.20, REGION_EU868},
+    {"Polotsk", 55.49, 28.79, REGION_EU868},
+    {"Orsha", 54.51, 30.41, REGION_EU868},
+    {"Mstislavl", 54.02, 31.72, REGION_EU868},
+    {"Minsk", 53.90, 27.56, REGION_EU868},
+    {"Gomel", 52.44, 30.99, REGION_EU868},
+    {"Dobrush", 52.41, 31.32, REGION_EU868},
+    {"Chernihiv", 51.50, 31.30, REGION_EU868},
+    {"Sumy", 50.91, 34.80, REGION_EU868},
+    {"Kharkiv", 49.99, 36.23, REGION_EU868},
+    {"Kyiv", 50.45, 30.52, REGION_EU868},
+    {"Mariupol", 47.10, 37.55, REGION_EU868},
+    {"Simferopol", 44.95, 34.10, REGION_EU868},
+    {"Mestia", 43.05, 42.73, REGION_EU868},
+    {"Tbilisi", 41.72, 44.79, REGION_EU868},
+    {"Quba", 41.36, 48.51, REGION_EU868},
+    {"Baku", 40.41, 49.87, REGION_EU868},
+    {"Uralsk", 51.23, 51.37, REGION_EU868},
+    {"Aktobe", 50.28, 57.20, REGION_EU868},
+    {"Kostanay", 53.21, 63.62, REGION_NO_GO},
+    {"Petropavl", 54.87, 69.14, REGION_NO_GO},
+    {"Pavlodar", 52.28, 76.95, REGION_NO_GO},
+    {"Semey", 50.41, 80.23, REGION_NO_GO},
+    {"Ulaangom", 49.98, 92.07, REGION_NO_GO},
+    {"Sukhbaatar", 50.23, 106.20, REGION_NO_GO},
+    {"Ulaanbaatar", 47.92, 106.92, REGION_NO_GO},
+    {"Choibalsan", 48.07, 114.50, REGION_NO_GO},
+    {"Wakkanai", 45.42, 141.67, REGION_AS923},
+    {"Izuhara", 34.20, 129.29, REGION_AS923},
+    {"Hitakatsu", 34.65, 129.47, REGION_AS923},
+    {"Shiretoko", 44.35, 145.35, REGION_AS923},
+    {"Nemuro", 43.33, 145.58, REGION_AS923},
+    {"Wales, Alaska", 65.61, -168.09, REGION_US915},
+    {"Nome", 64.50, -165.41, REGION_US915},
+
+    // Next to China and Pakistan
+    {"Hong Kong", 22.32, 114.17, REGION_AS923},
+    {"Taipei", 25.03, 121.57, REGION_AS923},
+    {"Hanoi", 21.03, 105.85, REGION_AS923},
+    {"Myitkyina", 25.38, 97.40, REGION_AS923},
+    {"Itanagar", 27.10, 93.60, REGION_IN865},
+    {"Leh", 34.16, 77.58, REGION_IN865},
+    {"Srinagar", 34.08, 74.80, REGION_IN865},
+    {"Jammu", 32.73, 74.86, REGION_IN865},
+    {"Amritsar", 31.63, 74.87, REGION_IN865},
+    {"Firozpur", 30.93, 74.61, REGION_IN865},
+    {"Fazilka", 30.40, 74.03, REGION_IN865},
+    {"Bikaner", 28.02, 73.31, REGION_IN865},
+    {"Jaisalmer", 26.92, 70.90, REGION_IN865},
+    {"Bhuj", 23.25, 69.67, REGION_IN865},
+    {"Kathmandu", 27.71, 85.32, REGION_IN865},
+    {"Bishkek", 42.87, 74.59, REGION_NO_GO},
+    {"Almaty", 43.24, 76.95, REGION_NO_GO},
+    {"Kabul", 34.53, 69.17, REGION_NO_GO},
+    {"Jalalabad", 34.43, 70.45, REGION_NO_GO},
+    {"Kandahar", 31.61, 65.71, REGION_NO_GO},
+
+    // Everywhere else
+    {"London", 51.51, -0.13, REGION_EU868},
+    {"Reykjavik", 64.15, -21.94, REGION_EU868},
+    {"Cape Town", -33.92, 18.42, REGION_EU868},
+    {"New York", 40.71, -74.01, REGION_US915},
+    {"Anchorage", 61.22, -149.90, REGION_US915},
+    {"Sao Paulo", -23.55, -46.63, REGION_AU915},
+    {"Sydney", -33.87, 151.21, REGION_AU915},
+    {"Tokyo", 35.68, 139.69, REGION_AS923},
+    {"Singapore", 1.35, 103.82, REGION_AS923},
+    {"Seoul", 37.57, 126.98, REGION_KR920},
+    {"Busan", 35.18, 129.08, REGION_KR920},
+    {"Paju", 37.76, 126.78, REGION_KR920},
+    {"Cheorwon", 38.15, 127.31, REGION_KR920},
+    {"Sokcho", 38.21, 128.59, REGION_KR920},
+    {"Ganghwa", 37.75, 126.49, REGION_KR920},
+    {"Ulleung", 37.48, 130.90, REGION_KR920},
+    {"Geoje", 34.88, 128.62, REGION_KR920},
+    {"Jeju", 33.50, 126.53, REGION_KR920},
+    {"Delhi", 28.61, 77.21, REGION_IN865},
+    {"Mumbai", 19.08, 72.88, REGION_IN865},
+    {"Kolkata", 22.57, 88.36, REGION_IN865}
+};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+int main(void) {
+    for (unsigned i = 0; i < ARRAY_SIZE(places); i++) {
+        const place_t &p = places[i];
+        lora_region_t got = region_lookup_packed(payload_pack_lat(p.lat), payload_pack_lon(p.lon));
+        bool ok = p.region == REGION_UNKNOWN ? got != REGION_NO_GO : got == p.region;
+        if (!ok) {
+            printf("%s (%.2f, %.2f): %s, expected %s\n", p.name, p.lat, p.lon,
+                   region_name(got), p.region == REGION_UNKNOWN ? "not NO-GO" : region_name(p.region));
+        }
+        CHECK(ok);
+    }
+    printf("%u places\n", (unsigned)ARRAY_SIZE(places));
+
+    // Only open ocean is left outside every polygon
+    CHECK(region_lookup(9000, 0) == REGION_UNKNOWN);
+    CHECK(region_lookup(-9000, 0) == REGION_UNKNOWN);
+    CHECK(region_lookup(0, 18000) == REGION_UNKNOWN);
+    CHECK(region_lookup(0, -18000) == REGION_UNKNOWN);
+    CHECK(region_lookup(2000, 6500) == REGION_UNKNOWN);     // Arabian Sea
+    CHECK(region_lookup(-2000, 8000) == REGION_UNKNOWN);    // Indian Ocean
+
+    // A keyframe must fit at every plan's datarate
+    static const lora_region_t plans[] = {
+        REGION_EU868, REGION_US915, REGION_AU915, REGION_AS923, REGION_IN865, REGION_KR920
+    };
+    for (unsigned i = 0; i < ARRAY_SIZE(plans); i++) {
+        region_datarate_t dr = region_datarate(plans[i]);
+        printf("%s: DR%u, %u bytes\n", region_name(plans[i]), dr.datarate, dr.max_payload);
+        CHECK(dr.max_payload >= PAYLOAD_MAX_LEN);
+    }
+    CHECK(region_datarate(REGION_US915).datarate > 0);
+    CHECK(region_datarate(REGION_AS923).datarate > 2);
+
+    return test_result();
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+/**
+ * gps.h only needs the parser's type
+ */
+class TinyGPSPlus {};
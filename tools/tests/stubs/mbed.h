@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Just enough of mbed for the board dependent code to build on the host
+ * against any board profile. The stubs record what was done to them so
+ * the probes can check it.
+ */
+enum PinName {
+    PA_0 = 0x00, PA_1, PA_2, PA_3, PA_4, PA_5, PA_6, PA_7,
+    PA_8, PA_9, PA_10, PA_11, PA_12, PA_13, PA_14, PA_15,
+    PB_0 = 0x10, PB_1, PB_2, PB_3, PB_4, PB_5, PB_6, PB_7,
+    PB_8, PB_9, PB_10, PB_11, PB_12, PB_13, PB_14, PB_15,
+    PC_0 = 0x20, PC_1, PC_2, PC_3, PC_4, PC_5, PC_6, PC_7,
+    PC_8, PC_9, PC_10, PC_11, PC_12, PC_13, PC_14, PC_15,
+    NC = -1
+};
+
+extern int stub_digital_out_writes;
+extern float stub_adc_value;
+extern int stub_deep_sleep_locks;
+
+class DigitalOut {
+public:
+    explicit DigitalOut(PinName pin) : _value(0) {}
+    void write(int value) {
+        _value = value;
+        stub_digital_out_writes++;
+    }
+    int read(void) const {
+        return _value;
+    }
+
+private:
+    int _value;
+};
+
+class AnalogIn {
+public:
+    explicit AnalogIn(PinName pin) {}
+    float read(void) {
+        return stub_adc_value;
+    }
+};
+
+inline void sleep_manager_lock_deep_sleep(void) {
+    stub_deep_sleep_locks++;
+}
+
+inline void sleep_manager_unlock_deep_sleep(void) {
+    stub_deep_sleep_locks--;
+}